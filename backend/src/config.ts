@@ -1,10 +1,12 @@
+import path from 'path';
+
 export const config = {
   port: process.env.PORT || 4001,
   cors: {
     origin: process.env.NODE_ENV === 'production' 
       ? [process.env.FRONTEND_URL || 'https://sf2lv2.islainstruments.com']  // Replace with your domain
       : ['http://localhost:3000', 'http://localhost:5173', '*'],
-    methods: ['GET', 'POST'],
+    methods: ['GET', 'POST', 'PUT'],
     allowedHeaders: ['Content-Type', 'Accept'],
     credentials: true,
     maxAge: 600
@@ -13,7 +15,43 @@ export const config = {
     fileSize: 1024 * 1024 * 1024, // 1GB
     fieldSize: 1024 * 1024 * 1024  // 1GB
   },
+  uploads: {
+    dir: 'uploads', // resumable uploads in progress inside tempDir, skipped by the hourly cleanup
+    chunkSize: 8 * 1024 * 1024, // 8MB per request of a resumable upload
+    sessionTimeout: 60 * 60 * 1000, // resumable uploads are dropped after 1 hour without a chunk
+    maxSessionsPerClient: Number(process.env.UPLOAD_SESSION_CLIENT_LIMIT) || 3 // open resumable uploads
+  },
   tempDir: process.env.TEMP_DIR || 'temp',
-  cleanupInterval: 60 * 60 * 1000, // 1 hour
+  buildCache: {
+    enabled: process.env.BUILD_CACHE !== '0',
+    dir: 'cache', // inside tempDir, skipped by the hourly cleanup
+    maxBytes: Number(process.env.BUILD_CACHE_MAX_BYTES) || 2 * 1024 * 1024 * 1024, // 2GB
+    builderImage: 'sf2lv2-builder'
+  },
+  builderPool: {
+    workers: Number(process.env.BUILDER_WORKERS) || 0, // 0 = one container per job
+    dir: 'pool', // job queue inside tempDir, skipped by the hourly cleanup
+    image: 'sf2lv2-builder',
+    healthInterval: 10 * 1000 // exited or outdated workers are re-created within 10 seconds
+  },
+  validator: {
+    // Built with "make validator" in sf2lv2
+    path: process.env.SF2_VALIDATOR || path.join(process.cwd(), '..', 'sf2lv2', 'build', 'sf2_validate'),
+    timeout: 10 * 1000 // 10 seconds
+  },
+  queue: {
+    concurrency: Number(process.env.BUILD_CONCURRENCY) || 0, // 0 = one build per CPU core
+    maxJobs: Number(process.env.BUILD_QUEUE_LIMIT) || 100, // uploaded, queued and building jobs
+    maxJobsPerClient: Number(process.env.BUILD_QUEUE_CLIENT_LIMIT) || 5, // the same, per client
+    jobRetention: 60 * 60 * 1000, // finished jobs and their files are kept for 1 hour
+    readyRetention: 10 * 60 * 1000 // uploads that are never built are dropped after 10 minutes
+  },
+  download: {
+    // With a web server in front, hand downloads to it (nginx X-Accel-Redirect)
+    // so it sends the file with sendfile. The prefix is an internal location
+    // mapped to tempDir; empty = Node streams the file itself
+    accelRedirectPrefix: process.env.DOWNLOAD_ACCEL_PREFIX || ''
+  },
+  cleanupInterval: 10 * 60 * 1000, // 10 minutes
   jobTimeout: 30 * 60 * 1000 // 30 minutes
 }; 
@@ -8,15 +8,15 @@ import downloadRouter from './routes/download';
 const app = express();
 const PORT = process.env.PORT || 4001;
 
-// Increase payload size limit and timeouts
-app.use(express.json({ limit: '1gb' }));
-app.use(express.urlencoded({ limit: '1gb', extended: true }));
-app.use(express.raw({ limit: '1gb' }));
+// Only small JSON and form bodies are parsed here; SoundFont uploads are
+// streamed to disk by the upload routes and must not be buffered
+app.use(express.json());
+app.use(express.urlencoded({ extended: true }));
 
 // Enable CORS with specific configuration
 app.use(cors({
   origin: ['http://localhost:3000', 'http://localhost:5173', 'https://sf2lv2.islainstruments.com'], // Allow both Vite and CRA default ports
-  methods: ['GET', 'POST'],
+  methods: ['GET', 'POST', 'PUT'],
   allowedHeaders: ['Content-Type', 'Accept'],
   credentials: true,
   maxAge: 600 // Increase preflight cache time
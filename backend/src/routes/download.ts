@@ -2,11 +2,15 @@ import { Router } from 'express';
 import path from 'path';
 import fs from 'fs';
 import { buildQueue } from '../utils/queue';
-import archiver from 'archiver';
+import { config } from '../config';
 
 const router = Router();
 
-router.get('/:jobId', async (req, res) => {
+// Serves the zip produced by the build (SoundFont stored, not deflated). A
+// job's archive never changes once built, so it is sent as an immutable file
+// with a strong ETag; Range, If-Range and conditional requests are handled by
+// res.download.
+router.get('/:jobId', (req, res) => {
   const { jobId } = req.params;
   
   // Get job details
@@ -21,64 +25,43 @@ router.get('/:jobId', async (req, res) => {
     return;
   }
 
-  // Get the plugin directory
-  const jobDir = path.join(process.cwd(), 'temp', jobId);
-  const pluginsDir = path.join(jobDir, 'plugins');
-  
-  // Path to the extracted plugin directory (not the entire plugins directory)
-  const pluginDir = path.join(pluginsDir, job.pluginName, `${job.pluginName}.lv2`);
-  
+  const zipFileName = `${job.pluginName}.zip`;
+  const zipFilePath = path.join(process.cwd(), config.tempDir, jobId, 'plugins', zipFileName);
+
   // Check if plugin exists
-  if (!fs.existsSync(pluginDir)) {
-    console.error(`Plugin directory not found: ${pluginDir}`);
+  if (!fs.existsSync(zipFilePath)) {
+    console.error(`Plugin archive not found: ${zipFilePath}`);
     res.status(404).json({ error: 'Plugin files not found' });
     return;
   }
 
-  // Create a zip file of the plugin
-  const zipFileName = `${job.pluginName}.zip`;
-  const zipFilePath = path.join(jobDir, zipFileName);
-
-  try {
-    // Create zip archive
-    const output = fs.createWriteStream(zipFilePath);
-    const archive = archiver('zip', {
-      zlib: { level: 9 } // Maximum compression
-    });
+  const etag = `"${job.id}"`;
+  const maxAge = config.queue.jobRetention; // the archive is removed with its job
 
-    output.on('close', () => {
-      // Send the zip file
-      res.download(zipFilePath, zipFileName, (err) => {
-        if (err) {
-          console.error('Error sending file:', err);
-        }
-        // Clean up zip file after sending
-        fs.unlink(zipFilePath, (unlinkErr) => {
-          if (unlinkErr) {
-            console.error('Error cleaning up zip file:', unlinkErr);
-          }
-        });
-      });
-    });
-
-    archive.on('error', (err: Error) => {
-      throw err;
-    });
-
-    archive.pipe(output);
-    
-    // Add the .lv2 directory to the root of the zip
-    // This ensures we're only zipping the actual plugin files and not any extra files
-    archive.directory(pluginDir, `${job.pluginName}.lv2`);
-    
-    archive.finalize();
-  } catch (error) {
-    console.error('Error creating zip file:', error);
-    res.status(500).json({ 
-      error: 'Failed to create plugin download',
-      details: error instanceof Error ? error.message : String(error)
+  if (config.download.accelRedirectPrefix) {
+    res.attachment(zipFileName);
+    res.set({
+      'ETag': etag,
+      'Cache-Control': `public, max-age=${Math.floor(maxAge / 1000)}, immutable`,
+      'X-Accel-Redirect': `${config.download.accelRedirectPrefix}/${jobId}/plugins/${encodeURIComponent(zipFileName)}`
     });
+    res.end();
+    return;
   }
+
+  res.download(zipFilePath, zipFileName, {
+    etag: false, // replaced by the job's strong ETag
+    headers: { 'ETag': etag },
+    maxAge,
+    immutable: true
+  }, (err) => {
+    if (err) {
+      console.error('Error sending file:', err);
+      if (!res.headersSent) {
+        res.status(500).json({ error: 'Failed to send plugin download' });
+      }
+    }
+  });
 });
 
-export default router; 
\ No newline at end of file
+export default router;
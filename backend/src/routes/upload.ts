@@ -1,19 +1,25 @@
-import { Router } from 'express';
+import { Router, Request, Response } from 'express';
 import multer from 'multer';
 import { createJob, simulateConversion } from '../utils/api';
 import path from 'path';
 import fs from 'fs';
 import { triggerDockerBuild } from '../utils/docker';
-import { buildQueue } from '../utils/queue';
+import { buildQueue, QueueFullError, FINISHED, Job } from '../utils/queue';
+import { validateSoundFont } from '../utils/validate';
+import {
+  soundFontStorage, createSession, countSessions, getSession, receiveChunk, completeSession,
+  dropSession, InvalidUploadError
+} from '../utils/uploads';
+import { config } from '../config';
 
 const router = Router();
 
-// Configure multer for memory storage with SF2 file validation
-const upload = multer({
-  storage: multer.memoryStorage(),
+// Multer for one upload, streaming the SoundFont to filepath (see utils/uploads)
+const createUpload = (filepath: string) => multer({
+  storage: soundFontStorage(() => filepath),
   limits: {
-    fileSize: 1024 * 1024 * 1024, // 1GB limit
-    fieldSize: 1024 * 1024 * 1024, // 1GB field size limit
+    fileSize: config.uploadLimits.fileSize,
+    fieldSize: config.uploadLimits.fieldSize,
   },
   fileFilter: (req, file, cb) => {
     // Check if file is a SoundFont file
@@ -26,7 +32,7 @@ const upload = multer({
 }).single('file');
 
 // Wrap multer in a promise to handle errors better
-const handleUpload = (req: any, res: any): Promise<any> => {
+const handleUpload = (req: any, res: any, filepath: string): Promise<any> => {
   return new Promise((resolve, reject) => {
     console.log('Starting upload handler');
     
@@ -34,11 +40,12 @@ const handleUpload = (req: any, res: any): Promise<any> => {
     let requestClosed = false;
     let uploadComplete = false;
     
-    // Handle request close
+    // Handle request close; the file is still being written to disk when the
+    // body has been read completely, so only a cut-off request counts
     req.on('close', () => {
-      requestClosed = true;
-      console.log('Request closed. Upload complete:', uploadComplete);
-      if (!uploadComplete) {
+      if (!req.complete) {
+        requestClosed = true;
+        console.log('Request closed. Upload complete:', uploadComplete);
         reject(new Error('Request closed before upload completed'));
       }
     });
@@ -55,15 +62,8 @@ const handleUpload = (req: any, res: any): Promise<any> => {
       reject(error);
     });
 
-    // Track data chunks
-    let totalBytesReceived = 0;
-    req.on('data', (chunk: Buffer) => {
-      totalBytesReceived += chunk.length;
-      console.log(`Received chunk: ${chunk.length} bytes. Total received: ${totalBytesReceived} bytes`);
-    });
-
     // Process the upload
-    upload(req, res, (err: any) => {
+    createUpload(filepath)(req, res, (err: any) => {
       if (requestClosed) {
         console.log('Upload callback called after request closed');
         return;
@@ -91,8 +91,7 @@ const handleUpload = (req: any, res: any): Promise<any> => {
       console.log('Upload successful:', {
         originalname: req.file.originalname,
         size: req.file.size,
-        mimetype: req.file.mimetype,
-        encoding: req.file.encoding
+        sha256: req.file.sha256
       });
 
       uploadComplete = true;
@@ -101,69 +100,240 @@ const handleUpload = (req: any, res: any): Promise<any> => {
   });
 };
 
+// Generate a clean plugin name from the original filename
+const pluginNameFor = (fileName: string): string => fileName
+  .toLowerCase()
+  .replace(/\.sf2$/i, '')
+  .replace(/[^a-z0-9]+/g, '_')
+  .replace(/^_+|_+$/g, ''); // Remove leading/trailing underscores
+
+// Create job-specific directories; the upload is written to the returned path
+const createJobDirs = (jobId: string) => {
+  const jobDir = path.join(process.cwd(), config.tempDir, jobId);
+  const jobInputDir = path.join(jobDir, 'input');
+  const jobPluginsDir = path.join(jobDir, 'plugins');
+  [jobDir, jobInputDir, jobPluginsDir].forEach(dir => {
+    if (!fs.existsSync(dir)) {
+      fs.mkdirSync(dir, { recursive: true });
+    }
+  });
+  return { jobDir, filepath: path.join(jobInputDir, 'soundfont.sf2') };
+};
+
+interface ReceivedUpload {
+  jobId: string;
+  jobDir: string;
+  filepath: string;
+  originalName: string;
+  size: number;
+  sha256: string;
+}
+
+// Validates a fully received SoundFont and registers its job
+const finishUpload = async (req: Request, res: Response, upload: ReceivedUpload) => {
+  const { jobId, jobDir, filepath } = upload;
+  const pluginName = pluginNameFor(upload.originalName);
+  console.log('File saved to:', filepath);
+
+  // Reject malformed or truncated SoundFonts before they reach a builder
+  const validation = await validateSoundFont(filepath);
+  if (!validation.valid) {
+    console.log('Upload route: Invalid SoundFont:', validation.error);
+    fs.rmSync(jobDir, { recursive: true, force: true });
+    res.status(400).json({
+      error: 'Invalid SoundFont file',
+      details: validation.error
+    });
+    return;
+  }
+
+  // Add job to queue but don't start processing yet
+  let job;
+  try {
+    job = buildQueue.addJob(filepath, pluginName, jobId, false, req.ip || 'anonymous', upload.sha256);
+  } catch (error) {
+    // Filled up while this upload was in flight
+    fs.rmSync(jobDir, { recursive: true, force: true });
+    throw error;
+  }
+
+  console.log('Upload route: Created job:', {
+    id: job.id,
+    status: job.status,
+    pluginName: job.pluginName
+  });
+
+  res.json({
+    success: true,
+    file: {
+      name: upload.originalName,
+      size: upload.size,
+      path: filepath,
+      pluginName
+    },
+    job: {
+      id: job.id,
+      status: job.status
+    }
+  });
+};
+
+const sendUploadError = (res: Response, error: unknown) => {
+  console.error('Upload route: Error during processing:', error);
+  if (res.headersSent) {
+    return;
+  }
+  if (error instanceof QueueFullError) {
+    res.set('Retry-After', '30');
+    res.status(503).json({ error: error.message });
+    return;
+  }
+  if (error instanceof InvalidUploadError) {
+    res.status(400).json({ error: 'Invalid SoundFont file', details: error.message });
+    return;
+  }
+  if (error instanceof multer.MulterError) {
+    res.status(400).json({ error: 'Upload rejected', details: error.message });
+    return;
+  }
+  res.status(500).json({ 
+    error: 'Failed to process file upload',
+    details: error instanceof Error ? error.message : String(error)
+  });
+};
+
+// Refuse before reading the body when the queue cannot take another job
+// from this client
+const rejectWhenFull = (req: Request, res: Response): boolean => {
+  const error = buildQueue.admissionError(req.ip || 'anonymous');
+  if (!error) {
+    return false;
+  }
+  console.log('Upload route:', error.message);
+  res.set('Retry-After', '30');
+  res.status(503).json({ error: error.message });
+  return true;
+};
+
 router.post('/', async (req, res) => {
   console.log('Upload route: Starting request handling');
   console.log('Upload route: Content-Length:', req.headers['content-length']);
   console.log('Upload route: Content-Type:', req.headers['content-type']);
-  
+
+  if (rejectWhenFull(req, res)) {
+    return;
+  }
+
+  const jobId = buildQueue.generateJobId();
+  const { jobDir, filepath } = createJobDirs(jobId);
+
   try {
-    const file = await handleUpload(req, res);
-    
-    // Generate a clean plugin name from the original filename
-    const cleanFileName = file.originalname
-      .toLowerCase()
-      .replace(/\.sf2$/i, '')
-      .replace(/[^a-z0-9]+/g, '_')
-      .replace(/^_+|_+$/g, ''); // Remove leading/trailing underscores
-    
-    // Create job-specific directories
-    const jobId = buildQueue.generateJobId();
-    const jobDir = path.join(process.cwd(), 'temp', jobId);
-    const jobInputDir = path.join(jobDir, 'input');
-    const jobPluginsDir = path.join(jobDir, 'plugins');
-    
-    // Ensure directories exist
-    [jobDir, jobInputDir, jobPluginsDir].forEach(dir => {
-      if (!fs.existsSync(dir)) {
-        fs.mkdirSync(dir, { recursive: true });
-      }
+    const file = await handleUpload(req, res, filepath);
+    await finishUpload(req, res, {
+      jobId,
+      jobDir,
+      filepath,
+      originalName: file.originalname,
+      size: file.size,
+      sha256: file.sha256
     });
-    
-    // Save the file with a clean name
-    const savedFileName = `soundfont.sf2`;
-    const filepath = path.join(jobInputDir, savedFileName);
-    fs.writeFileSync(filepath, file.buffer);
-    
-    console.log('File saved to:', filepath);
+  } catch (error) {
+    if (!buildQueue.getJob(jobId)) {
+      fs.rmSync(jobDir, { recursive: true, force: true });
+    }
+    sendUploadError(res, error);
+  }
+});
 
-    // Add job to queue but don't start processing yet
-    const job = buildQueue.addJob(filepath, cleanFileName, jobId, false);
+// Resumable upload: start a session for a file of the given name and size
+router.post('/sessions', (req, res) => {
+  const { fileName, size } = req.body || {};
 
-    console.log('Upload route: Created job:', {
-      id: job.id,
-      status: job.status,
-      pluginName: job.pluginName
-    });
+  if (typeof fileName !== 'string' || !fileName.toLowerCase().endsWith('.sf2')) {
+    return res.status(400).json({ error: 'Only .sf2 files are allowed' });
+  }
+  if (!Number.isInteger(size) || size < 12 || size > config.uploadLimits.fileSize) {
+    return res.status(400).json({ error: 'Invalid file size' });
+  }
+  if (rejectWhenFull(req, res)) {
+    return;
+  }
+  // Sessions are not jobs yet, so they are limited on their own
+  const clientId = req.ip || 'anonymous';
+  if (countSessions(clientId) >= config.uploads.maxSessionsPerClient) {
+    console.log('Upload route: Too many open upload sessions for', clientId);
+    res.set('Retry-After', '30');
+    return res.status(429).json({ error: 'Too many uploads in progress, please finish or wait for one first' });
+  }
 
-    res.json({
-      success: true,
-      file: {
-        name: file.originalname,
-        size: file.size,
-        path: filepath,
-        pluginName: cleanFileName
-      },
-      job: {
-        id: job.id,
-        status: job.status
-      }
-    });
+  const session = createSession(fileName, size, clientId);
+  console.log('Upload route: Started resumable upload:', { id: session.id, fileName, size });
+  res.json({ uploadId: session.id, offset: 0, chunkSize: config.uploads.chunkSize });
+});
+
+// Where to resume a session
+router.get('/sessions/:uploadId', (req, res) => {
+  const session = getSession(req.params.uploadId);
+  if (!session) {
+    return res.status(404).json({ error: 'Upload not found' });
+  }
+  res.json({ uploadId: session.id, offset: session.offset, size: session.size });
+});
+
+// Append the request body (application/octet-stream, at most chunkSize
+// bytes) at ?offset=, which must be the session's current offset
+router.put('/sessions/:uploadId', async (req, res) => {
+  const session = getSession(req.params.uploadId);
+  if (!session) {
+    return res.status(404).json({ error: 'Upload not found' });
+  }
+  if (session.busy || Number(req.query.offset) !== session.offset) {
+    return res.status(409).json({ error: 'Chunk does not continue the upload', offset: session.offset });
+  }
+
+  try {
+    await receiveChunk(session, req);
+    res.json({ offset: session.offset });
   } catch (error) {
-    console.error('Upload route: Error during processing:', error);
-    res.status(500).json({ 
-      error: 'Failed to process file upload',
-      details: error instanceof Error ? error.message : String(error)
+    if (error instanceof InvalidUploadError) {
+      dropSession(session);
+    }
+    sendUploadError(res, error);
+  }
+});
+
+// Finish a session: the file becomes a job like a regular upload
+router.post('/sessions/:uploadId/complete', async (req, res) => {
+  const session = getSession(req.params.uploadId);
+  if (!session) {
+    return res.status(404).json({ error: 'Upload not found' });
+  }
+  if (session.busy || session.offset !== session.size) {
+    return res.status(409).json({ error: 'Upload is not complete', offset: session.offset });
+  }
+  if (rejectWhenFull(req, res)) {
+    return;
+  }
+
+  const jobId = buildQueue.generateJobId();
+  const { jobDir, filepath } = createJobDirs(jobId);
+
+  try {
+    const sha256 = completeSession(session, filepath);
+    await finishUpload(req, res, {
+      jobId,
+      jobDir,
+      filepath,
+      originalName: session.fileName,
+      size: session.size,
+      sha256
     });
+  } catch (error) {
+    if (!buildQueue.getJob(jobId)) {
+      fs.rmSync(jobDir, { recursive: true, force: true });
+    }
+    dropSession(session);
+    sendUploadError(res, error);
   }
 });
 
@@ -183,4 +353,48 @@ router.get('/status/:jobId', (req, res) => {
   res.json(job);
 });
 
+// Push job updates as server-sent events: one `data:` message with the job's
+// status and build stage on connect and after every change. The stream ends
+// once the job has finished. Clients that cannot keep the stream open poll
+// the status endpoint above instead.
+router.get('/status/:jobId/events', (req, res) => {
+  const { jobId } = req.params;
+  const job = buildQueue.getJob(jobId);
+  if (!job) {
+    res.status(404).json({ error: 'Job not found' });
+    return;
+  }
+
+  res.set({
+    'Content-Type': 'text/event-stream',
+    'Cache-Control': 'no-cache',
+    'Connection': 'keep-alive',
+    'X-Accel-Buffering': 'no' // do not let a proxy buffer the stream
+  });
+  res.flushHeaders();
+
+  // The build output is left out; it is large and only needed on failure
+  const send = (update: Job) => {
+    const { output, ...event } = update;
+    res.write(`data: ${JSON.stringify(event)}\n\n`);
+  };
+
+  const keepAlive = setInterval(() => res.write(': keep-alive\n\n'), 15000);
+  const close = () => {
+    clearInterval(keepAlive);
+    buildQueue.off(jobId, onUpdate);
+    res.end();
+  };
+  const onUpdate = (update: Job) => {
+    send(update);
+    if (FINISHED.includes(update.status)) {
+      close();
+    }
+  };
+
+  req.on('close', close);
+  buildQueue.on(jobId, onUpdate);
+  onUpdate(job);
+});
+
 export default router; 
\ No newline at end of file
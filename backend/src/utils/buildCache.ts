@@ -0,0 +1,144 @@
+import crypto from 'crypto';
+import path from 'path';
+import fs from 'fs';
+import { promisify } from 'util';
+import { execFile } from 'child_process';
+import { config } from '../config';
+
+const execFileAsync = promisify(execFile);
+
+// Content-addressed cache of built plugin zips.
+//
+// A build is fully determined by the SoundFont bytes, the builder image and
+// the plugin name (which ends up in the bundle), so the sha256 of those three
+// (with the SoundFont as its own sha256) names the artifact. Entries live in <tempDir>/cache/<key>.zip; a hit bumps
+// the file's mtime, and eviction removes the oldest entries until the cache
+// fits in config.buildCache.maxBytes.
+
+const cacheDir = path.join(process.cwd(), config.tempDir, config.buildCache.dir);
+
+// The builder image id, or BUILDER_VERSION when set; null (no caching) if
+// neither is available. Resolved again for every build (inspecting the image
+// takes milliseconds), so an image rebuilt while the backend runs gets its
+// own cache keys instead of being served the old image's artifacts.
+async function getBuilderVersion(): Promise<string | null> {
+  if (process.env.BUILDER_VERSION) {
+    return process.env.BUILDER_VERSION;
+  }
+  try {
+    const { stdout } = await execFileAsync('docker', [
+      'image', 'inspect', '--format', '{{.Id}}', config.buildCache.builderImage
+    ]);
+    return stdout.trim() || null;
+  } catch (error) {
+    console.error('Build cache: could not determine builder version, not caching this build:', error);
+    return null;
+  }
+}
+
+function hashFile(filePath: string): Promise<string> {
+  const hash = crypto.createHash('sha256');
+  return new Promise((resolve, reject) => {
+    fs.createReadStream(filePath)
+      .on('data', chunk => hash.update(chunk))
+      .on('end', () => resolve(hash.digest('hex')))
+      .on('error', reject);
+  });
+}
+
+// contentHash is the sha256 of the SoundFont when the upload already computed
+// it; otherwise the file is read again to hash it
+export async function getCacheKey(soundfontPath: string, pluginName: string,
+                                  contentHash?: string): Promise<string | null> {
+  if (!config.buildCache.enabled) {
+    return null;
+  }
+
+  const version = await getBuilderVersion();
+  if (!version) {
+    return null;
+  }
+
+  const content = contentHash || await hashFile(soundfontPath);
+  return crypto.createHash('sha256')
+    .update(content + '\0' + version + '\0' + pluginName)
+    .digest('hex');
+}
+
+function entryPath(key: string): string {
+  return path.join(cacheDir, `${key}.zip`);
+}
+
+// Places the cached zip for key at targetPath. Returns false on a miss.
+export function fetchCached(key: string, targetPath: string): boolean {
+  const cached = entryPath(key);
+  try {
+    const now = new Date();
+    fs.utimesSync(cached, now, now);
+  } catch {
+    return false;
+  }
+
+  try {
+    fs.rmSync(targetPath, { force: true });
+    try {
+      fs.linkSync(cached, targetPath);
+    } catch {
+      fs.copyFileSync(cached, targetPath);
+    }
+    return true;
+  } catch (error) {
+    console.error('Build cache: failed to reuse entry', key, error);
+    return false;
+  }
+}
+
+// Adds a freshly built zip under key, then evicts down to the size cap.
+export function storeCached(key: string, zipPath: string): void {
+  try {
+    fs.mkdirSync(cacheDir, { recursive: true });
+
+    // Copy under a temporary name and rename, so a concurrent lookup never
+    // sees a partial zip
+    const tmpPath = path.join(cacheDir, `${key}.${process.pid}.${Date.now()}.tmp`);
+    fs.copyFileSync(zipPath, tmpPath);
+    fs.renameSync(tmpPath, entryPath(key));
+  } catch (error) {
+    console.error('Build cache: failed to store entry', key, error);
+    return;
+  }
+
+  evict();
+}
+
+function evict(): void {
+  let entries: { file: string; size: number; mtimeMs: number }[];
+  try {
+    entries = fs.readdirSync(cacheDir)
+      .filter(name => name.endsWith('.zip'))
+      .map(name => {
+        const file = path.join(cacheDir, name);
+        const stats = fs.statSync(file);
+        return { file, size: stats.size, mtimeMs: stats.mtimeMs };
+      });
+  } catch (error) {
+    console.error('Build cache: failed to scan cache directory', error);
+    return;
+  }
+
+  let total = entries.reduce((sum, entry) => sum + entry.size, 0);
+  entries.sort((a, b) => a.mtimeMs - b.mtimeMs);
+
+  for (const entry of entries) {
+    if (total <= config.buildCache.maxBytes) {
+      break;
+    }
+    try {
+      fs.unlinkSync(entry.file);
+      total -= entry.size;
+      console.log('Build cache: evicted', path.basename(entry.file));
+    } catch (error) {
+      console.error('Build cache: failed to evict', entry.file, error);
+    }
+  }
+}
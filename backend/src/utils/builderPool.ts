@@ -0,0 +1,266 @@
+import path from 'path';
+import fs from 'fs';
+import { promisify } from 'util';
+import { execFile } from 'child_process';
+import { config } from '../config';
+
+const execFileAsync = promisify(execFile);
+
+// Pool of long-lived builder containers.
+//
+// Each worker runs `build.sh --worker /jobs` with the temp directory mounted
+// at /jobs, so the prebuilt runtime and tools stay warm between jobs. Jobs are
+// handed over through a queue directory: the backend drops a ticket named
+// after the job id into pool/pending, and the first idle worker claims it by
+// renaming it into pool/active. The worker builds from /jobs/<jobId>/input
+// into /jobs/<jobId>/plugins, records its name in build.worker, streams its
+// log to build.log in the job directory and writes the exit code to
+// build.exit when done.
+
+export interface PoolResult {
+  code: number;
+  output: string;
+}
+
+const POLL_INTERVAL = 250; // ms
+
+// Environment shared with the one-shot builder containers
+export const builderEnv = [
+  '-e', 'TERM=xterm-256color',
+  '-e', 'CROSS_COMPILE=aarch64-linux-gnu-',
+  '-e', 'CC=aarch64-linux-gnu-gcc',
+  '-e', 'CXX=aarch64-linux-gnu-g++',
+  '-e', 'AR=aarch64-linux-gnu-ar',
+  '-e', 'LD=aarch64-linux-gnu-ld',
+  '-e', 'STRIP=aarch64-linux-gnu-strip',
+  // Add debug flag to show detailed output during build
+  '-e', 'DEBUG=1'
+];
+
+export class BuilderPool {
+  private tempDir: string;
+  private queueDir: string;
+  private started: Promise<void> | null;
+  private restarts: Promise<void>;
+  // Builds waiting for a worker, by job id, with the function that fails them
+  private inFlight: Map<string, (error: Error) => void>;
+
+  constructor() {
+    this.tempDir = path.normalize(path.join(process.cwd(), config.tempDir));
+    this.queueDir = path.join(this.tempDir, config.builderPool.dir);
+    this.started = null;
+    this.restarts = Promise.resolve();
+    this.inFlight = new Map();
+  }
+
+  get enabled(): boolean {
+    return config.builderPool.workers > 0;
+  }
+
+  // (Re)creates the worker containers, so they always run the current image,
+  // and starts checking on them
+  private start(): Promise<void> {
+    if (!this.started) {
+      this.started = (async () => {
+        fs.mkdirSync(path.join(this.queueDir, 'pending'), { recursive: true });
+        fs.mkdirSync(path.join(this.queueDir, 'active'), { recursive: true });
+
+        // Tickets claimed by workers of a previous backend run are lost
+        for (const ticket of fs.readdirSync(path.join(this.queueDir, 'active'))) {
+          fs.rmSync(path.join(this.queueDir, 'active', ticket), { force: true });
+        }
+
+        for (let i = 0; i < config.builderPool.workers; i++) {
+          await this.startWorker(`sf2lv2-worker-${i}`);
+        }
+        setInterval(() => this.checkWorkers(), config.builderPool.healthInterval).unref();
+      })().catch(error => {
+        this.started = null; // retry on the next job
+        throw error;
+      });
+    }
+    return this.started;
+  }
+
+  // Replaces the named worker container with a fresh one. A build the old
+  // container had claimed is failed, since removing the container stops it.
+  private async startWorker(name: string): Promise<void> {
+    await execFileAsync('docker', ['rm', '-f', name]).catch(() => undefined);
+    this.failClaimedBy(name, `Builder worker ${name} stopped during the build`);
+    await execFileAsync('docker', [
+      'run', '-d', '--rm',
+      ...builderEnv,
+      '--name', name,
+      '-v', `${this.tempDir}:/jobs`,
+      config.builderPool.image,
+      '/build/build.sh', '--worker', '/jobs', name
+    ]);
+    console.log('Builder pool: started worker', name);
+  }
+
+  // Restarts run one at a time, so the health check and a timeout never
+  // replace the same worker twice
+  private restartWorker(name: string): Promise<void> {
+    this.restarts = this.restarts
+      .then(() => this.startWorker(name))
+      .catch(error => console.error('Builder pool: failed to restart worker', name, error));
+    return this.restarts;
+  }
+
+  // The worker building a job, as recorded by build.sh when it claims the ticket
+  private claimedBy(jobId: string): string | null {
+    try {
+      return fs.readFileSync(path.join(this.tempDir, jobId, 'build.worker'), 'utf8').trim() || null;
+    } catch {
+      return null;
+    }
+  }
+
+  private busyWorkers(): Set<string> {
+    const busy = new Set<string>();
+    for (const jobId of this.inFlight.keys()) {
+      const worker = this.claimedBy(jobId);
+      if (worker) {
+        busy.add(worker);
+      }
+    }
+    return busy;
+  }
+
+  private failClaimedBy(name: string, message: string) {
+    for (const [jobId, fail] of this.inFlight) {
+      if (this.claimedBy(jobId) === name && !fs.existsSync(path.join(this.tempDir, jobId, 'build.exit'))) {
+        fs.rmSync(path.join(this.queueDir, 'active', jobId), { force: true });
+        fail(new Error(message));
+      }
+    }
+  }
+
+  // Re-creates workers that have exited (they run with --rm, so an exited
+  // worker is gone) and idle workers still running an outdated image
+  private async checkWorkers(): Promise<void> {
+    const image = await execFileAsync('docker', [
+      'image', 'inspect', '--format', '{{.Id}}', config.builderPool.image
+    ]).then(({ stdout }) => stdout.trim(), () => null);
+    const busy = this.busyWorkers();
+
+    for (let i = 0; i < config.builderPool.workers; i++) {
+      const name = `sf2lv2-worker-${i}`;
+      const state = await execFileAsync('docker', [
+        'inspect', '--format', '{{.State.Running}} {{.Image}}', name
+      ]).then(({ stdout }) => stdout.trim().split(' '), () => ['false', '']);
+
+      if (state[0] !== 'true') {
+        console.warn('Builder pool: worker', name, 'is not running, restarting it');
+        await this.restartWorker(name);
+      } else if (image && state[1] !== image && !busy.has(name)) {
+        console.log('Builder pool: worker', name, 'runs an outdated image, restarting it');
+        await this.restartWorker(name);
+      }
+    }
+  }
+
+  // Queues a build of <jobId>/input/soundfont.sf2 and waits for a worker to
+  // finish it. onOutput receives the build log as it grows. The timeout runs
+  // from the moment a worker claims the job; a worker that overruns it is
+  // restarted, which stops the build before the job is reported as failed.
+  async build(jobId: string, pluginName: string, onOutput?: (text: string) => void): Promise<PoolResult> {
+    await this.start();
+
+    const jobDir = path.join(this.tempDir, jobId);
+    const logPath = path.join(jobDir, 'build.log');
+    const exitPath = path.join(jobDir, 'build.exit');
+    fs.rmSync(logPath, { force: true });
+    fs.rmSync(exitPath, { force: true });
+    fs.rmSync(path.join(jobDir, 'build.worker'), { force: true });
+
+    // Write the ticket next to the queue and rename it in, so workers never
+    // read a partial one
+    const ticketTmp = path.join(this.queueDir, `${jobId}.tmp`);
+    const ticket = path.join(this.queueDir, 'pending', jobId);
+    fs.writeFileSync(ticketTmp, `${pluginName}\n`);
+    fs.renameSync(ticketTmp, ticket);
+
+    return new Promise((resolve, reject) => {
+      let deadline: number | null = null;
+      let offset = 0;
+      let output = '';
+      let done = false;
+
+      const finish = (error: Error | null, result?: PoolResult) => {
+        if (done) {
+          return;
+        }
+        done = true;
+        this.inFlight.delete(jobId);
+        if (error) {
+          reject(error);
+        } else {
+          resolve(result!);
+        }
+      };
+      this.inFlight.set(jobId, error => finish(error));
+
+      const readLog = () => {
+        let fd: number;
+        try {
+          fd = fs.openSync(logPath, 'r');
+        } catch {
+          return; // not claimed yet
+        }
+        try {
+          const size = fs.fstatSync(fd).size;
+          if (size > offset) {
+            const chunk = Buffer.alloc(size - offset);
+            fs.readSync(fd, chunk, 0, chunk.length, offset);
+            offset = size;
+            const text = chunk.toString();
+            output += text;
+            onOutput?.(text);
+          }
+        } finally {
+          fs.closeSync(fd);
+        }
+      };
+
+      const poll = () => {
+        if (done) {
+          return;
+        }
+        try {
+          readLog();
+
+          if (fs.existsSync(exitPath)) {
+            readLog();
+            const code = parseInt(fs.readFileSync(exitPath, 'utf8'), 10);
+            finish(null, { code: isNaN(code) ? 1 : code, output });
+            return;
+          }
+
+          const worker = this.claimedBy(jobId);
+          if (worker && deadline === null) {
+            deadline = Date.now() + config.jobTimeout;
+          }
+          if (worker && deadline !== null && Date.now() > deadline) {
+            // Stop the build first, so nothing writes into the job directory
+            // once it is reported as failed
+            this.inFlight.delete(jobId);
+            fs.rmSync(path.join(this.queueDir, 'active', jobId), { force: true });
+            this.restartWorker(worker).then(() =>
+              finish(new Error(`Build timed out after ${config.jobTimeout / 1000}s`)));
+            return;
+          }
+        } catch (error) {
+          finish(error as Error);
+          return;
+        }
+        setTimeout(poll, POLL_INTERVAL);
+      };
+
+      poll();
+    });
+  }
+}
+
+// Export singleton instance
+export const builderPool = new BuilderPool();
@@ -3,6 +3,8 @@ import path from 'path';
 import fs from 'fs';
 import { promisify } from 'util';
 import { exec } from 'child_process';
+import { builderPool, builderEnv } from './builderPool';
+import { config } from '../config';
 
 const execAsync = promisify(exec);
 
@@ -10,12 +12,28 @@ interface BuildOptions {
   soundfontPath: string;
   pluginName: string;
   jobId: string;
+  onOutput?: (text: string) => void; // build log as it arrives
 }
 
-export async function triggerDockerBuild({ soundfontPath, pluginName, jobId }: BuildOptions): Promise<string> {
+// Checks <pluginsDir>/<pluginName>.zip holds a complete bundle. The zip is
+// served for download as it is, so it is only listed, not unpacked. Used for
+// fresh builds and build cache hits.
+export async function verifyPlugin(pluginsDir: string, pluginName: string): Promise<void> {
+  const zipPath = path.normalize(path.join(pluginsDir, `${pluginName}.zip`));
+
+  const { stdout } = await execAsync(`unzip -Z1 "${zipPath}"`);
+  const entries = stdout.split('\n').map(line => line.trim());
+
+  // Verify the soundfont.sf2 file exists in the plugin
+  if (!entries.includes(`${pluginName}.lv2/soundfont.sf2`)) {
+    throw new Error('soundfont.sf2 not found in plugin archive');
+  }
+}
+
+export async function triggerDockerBuild({ soundfontPath, pluginName, jobId, onOutput }: BuildOptions): Promise<string> {
   return new Promise((resolve, reject) => {
     // Create job-specific paths with normalized paths to avoid double/triple slashes
-    const jobDir = path.normalize(path.join(process.cwd(), 'temp', jobId));
+    const jobDir = path.normalize(path.join(process.cwd(), config.tempDir, jobId));
     const jobPluginsDir = path.normalize(path.join(jobDir, 'plugins'));
     const jobInputDir = path.normalize(path.join(jobDir, 'input'));
 
@@ -42,13 +60,16 @@ export async function triggerDockerBuild({ soundfontPath, pluginName, jobId }: B
     const sourceFile = path.normalize(path.join(jobInputDir, actualFileName));
     const targetFile = path.normalize(path.join(jobInputDir, correctFileName));
     
-    try {
-      // Copy the file with the new name
-      fs.copyFileSync(sourceFile, targetFile);
-      console.log('Copied soundfont file with correct name:', correctFileName);
-    } catch (error) {
-      reject(new Error(`Failed to copy soundfont file: ${error}`));
-      return;
+    // Uploads are already saved under that name; anything else is renamed
+    // rather than copied, as SoundFonts can be hundreds of megabytes
+    if (actualFileName !== correctFileName) {
+      try {
+        fs.renameSync(sourceFile, targetFile);
+        console.log('Renamed soundfont file to:', correctFileName);
+      } catch (error) {
+        reject(new Error(`Failed to rename soundfont file: ${error}`));
+        return;
+      }
     }
 
     // Ensure job directories exist with clean normalized paths
@@ -66,21 +87,54 @@ export async function triggerDockerBuild({ soundfontPath, pluginName, jobId }: B
     }
     console.log('Verified input file exists:', fullInputPath);
     
+    const completeBuild = async (code: number | null, output: string, errorOutput: string) => {
+      if (code === 0) {
+        // Check if the output file exists
+        const expectedZipPath = path.normalize(path.join(jobPluginsDir, `${pluginName}.zip`));
+        console.log('Checking for output file:', expectedZipPath);
+        if (fs.existsSync(expectedZipPath)) {
+          console.log('Build successful, output file found');
+          
+          try {
+            await verifyPlugin(jobPluginsDir, pluginName);
+            resolve(output);
+          } catch (error: any) {
+            console.error('Error verifying plugin:', error);
+            reject(new Error(`Failed to verify plugin: ${error.message}`));
+          }
+        } else {
+          console.error('Build completed but output file not found');
+          reject(new Error('Build completed but plugin zip file not found'));
+        }
+      } else {
+        console.error('Docker build failed:', {
+          code,
+          output,
+          errorOutput
+        });
+        reject(new Error(`Docker build failed with code ${code}: ${errorOutput}`));
+      }
+    };
+
+    // Hand the job to a warm worker when the pool is enabled
+    if (builderPool.enabled) {
+      console.log('Queueing build on the builder pool:', jobId);
+      builderPool.build(jobId, pluginName, onOutput)
+        .then(({ code, output }) => completeBuild(code, output, code === 0 ? '' : output))
+        .catch((error) => {
+          console.error('Builder pool error:', error);
+          reject(new Error(`Builder pool error: ${error.message}`));
+        });
+      return;
+    }
+
     // Create the Docker command with job-specific container name and volumes
     // Use absolute paths with normalization to prevent path issues
     const dockerCommand = 'docker';
     const args = [
       'run',
       '--rm',
-      '-e', 'TERM=xterm-256color',
-      '-e', 'CROSS_COMPILE=aarch64-linux-gnu-',
-      '-e', 'CC=aarch64-linux-gnu-gcc',
-      '-e', 'CXX=aarch64-linux-gnu-g++',
-      '-e', 'AR=aarch64-linux-gnu-ar',
-      '-e', 'LD=aarch64-linux-gnu-ld',
-      '-e', 'STRIP=aarch64-linux-gnu-strip',
-      // Add debug flag to show detailed output during build
-      '-e', 'DEBUG=1',
+      ...builderEnv,
       '--name', `sf2lv2-builder-${jobId}`,
       '-v', `${jobInputDir}:/input`,
       '-v', `${jobPluginsDir}:/output`,
@@ -102,6 +156,7 @@ export async function triggerDockerBuild({ soundfontPath, pluginName, jobId }: B
       const text = data.toString();
       console.log('Docker stdout:', text);
       output += text;
+      onOutput?.(text);
     });
 
     dockerProcess.stderr.on('data', (data) => {
@@ -110,50 +165,9 @@ export async function triggerDockerBuild({ soundfontPath, pluginName, jobId }: B
       errorOutput += text;
     });
 
-    dockerProcess.on('close', async (code) => {
+    dockerProcess.on('close', (code) => {
       console.log('Docker process closed with code:', code);
-      if (code === 0) {
-        // Check if the output file exists
-        const expectedZipPath = path.normalize(path.join(jobPluginsDir, `${pluginName}.zip`));
-        console.log('Checking for output file:', expectedZipPath);
-        if (fs.existsSync(expectedZipPath)) {
-          console.log('Build successful, output file found');
-          
-          // Extract the zip file to a clean normalized path
-          const extractDir = path.normalize(path.join(jobPluginsDir, pluginName));
-          if (!fs.existsSync(extractDir)) {
-            fs.mkdirSync(extractDir, { recursive: true });
-          }
-          
-          try {
-            // Extract the zip file
-            await execAsync(`unzip -o "${expectedZipPath}" -d "${extractDir}"`);
-            
-            // Verify the soundfont.sf2 file exists in the extracted plugin
-            const pluginDir = path.normalize(path.join(extractDir, `${pluginName}.lv2`));
-            const soundfontPath = path.normalize(path.join(pluginDir, 'soundfont.sf2'));
-            
-            if (!fs.existsSync(soundfontPath)) {
-              throw new Error('soundfont.sf2 not found in extracted plugin');
-            }
-            
-            resolve(output);
-          } catch (error: any) {
-            console.error('Error extracting or verifying plugin:', error);
-            reject(new Error(`Failed to extract or verify plugin: ${error.message}`));
-          }
-        } else {
-          console.error('Build completed but output file not found');
-          reject(new Error('Build completed but plugin zip file not found'));
-        }
-      } else {
-        console.error('Docker build failed:', {
-          code,
-          output,
-          errorOutput
-        });
-        reject(new Error(`Docker build failed with code ${code}: ${errorOutput}`));
-      }
+      completeBuild(code, output, errorOutput);
     });
 
     dockerProcess.on('error', (error) => {
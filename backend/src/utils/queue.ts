@@ -1,7 +1,11 @@
 import { v4 as uuidv4 } from 'uuid';
+import { EventEmitter } from 'events';
 import path from 'path';
 import fs from 'fs';
-import { triggerDockerBuild } from './docker';
+import os from 'os';
+import { triggerDockerBuild, verifyPlugin } from './docker';
+import { getCacheKey, fetchCached, storeCached } from './buildCache';
+import { config } from '../config';
 
 export type JobStatus = 
   | 'idle'
@@ -11,6 +15,7 @@ export type JobStatus =
   | 'building'
   | 'packaging'
   | 'ready'
+  | 'queued'
   | 'complete'
   | 'failed'
   | 'error';
@@ -19,37 +24,114 @@ export interface Job {
   id: string;
   soundfontPath: string;
   pluginName: string;
+  clientId: string; // jobs are scheduled round-robin between clients
+  contentHash?: string; // sha256 of the SoundFont, computed while it was uploaded
   status: JobStatus;
   error?: string;
   output?: string;
+  progress?: string; // latest build log line
+  stage?: string; // build stage reported by build.sh (STAGE lines)
+  percent?: number; // build progress of that stage, 0-100
   created: Date;
   updated: Date;
 }
 
-export class BuildQueue {
+// Thrown by addJob when the queue, or the client's share of it, is at its
+// admission limit
+export class QueueFullError extends Error {
+  constructor(message = 'Build queue is full, please try again later') {
+    super(message);
+    this.name = 'QueueFullError';
+  }
+}
+
+interface Waiter {
+  resolve: () => void;
+  reject: (error: unknown) => void;
+}
+
+export const FINISHED: JobStatus[] = ['complete', 'failed', 'error'];
+
+// build.sh reports its progress as "STAGE <percent> <name>" lines
+const STAGE_LINE = /^STAGE (\d+) (\w+)$/;
+
+// Emits the job, under its id, whenever its status or build stage changes
+export class BuildQueue extends EventEmitter {
   private jobs: Map<string, Job>;
-  private processing: boolean;
+  private running: number;
+  private concurrency: number;
+
+  // Waiting jobs, one FIFO per client, and the round-robin order of clients
+  // that have jobs waiting
+  private waiting: Map<string, string[]>;
+  private clients: string[];
+  private waiters: Map<string, Waiter>;
 
   constructor() {
+    super();
+    this.setMaxListeners(0); // one listener per open progress stream
     this.jobs = new Map();
-    this.processing = false;
+    this.running = 0;
+    this.concurrency = config.queue.concurrency || os.cpus().length;
+    this.waiting = new Map();
+    this.clients = [];
+    this.waiters = new Map();
     
     // Ensure temp directory exists
-    const tempDir = path.join(process.cwd(), 'temp');
+    const tempDir = path.join(process.cwd(), config.tempDir);
     if (!fs.existsSync(tempDir)) {
       fs.mkdirSync(tempDir, { recursive: true });
     }
   }
 
+  // An upload that was never built expires long before finished jobs, so
+  // abandoned uploads do not hold admission slots for long
+  private expired(job: Job, now: number): boolean {
+    const retention = job.status === 'ready' ? config.queue.readyRetention : config.queue.jobRetention;
+    return now - job.updated.getTime() > retention;
+  }
+
+  // Why no more jobs are admitted for the client, or null if one is.
+  // Finished jobs and expired uploads do not count.
+  admissionError(clientId: string): QueueFullError | null {
+    const now = Date.now();
+    let active = 0;
+    let clientActive = 0;
+    for (const job of this.jobs.values()) {
+      if (FINISHED.includes(job.status) || (job.status === 'ready' && this.expired(job, now))) {
+        continue;
+      }
+      active++;
+      if (job.clientId === clientId) {
+        clientActive++;
+      }
+    }
+    if (active >= config.queue.maxJobs) {
+      return new QueueFullError();
+    }
+    if (clientActive >= config.queue.maxJobsPerClient) {
+      return new QueueFullError('Too many of your files are waiting to be built, please try again later');
+    }
+    return null;
+  }
+
   generateJobId(): string {
     return uuidv4();
   }
 
-  addJob(soundfontPath: string, pluginName: string, jobId: string, startProcessing: boolean = false): Job {
+  addJob(soundfontPath: string, pluginName: string, jobId: string, startProcessing: boolean = false,
+         clientId: string = 'anonymous', contentHash?: string): Job {
+    const error = this.admissionError(clientId);
+    if (error) {
+      throw error;
+    }
+
     const job: Job = {
       id: jobId,
       soundfontPath,
       pluginName,
+      clientId,
+      contentHash,
       status: 'ready',
       created: new Date(),
       updated: new Date()
@@ -64,37 +146,133 @@ export class BuildQueue {
     return job;
   }
 
-  async processJob(jobId: string): Promise<void> {
+  // Queues the job and resolves once it has been built (or rejects with the
+  // build error). Up to `concurrency` jobs build at once.
+  processJob(jobId: string): Promise<void> {
     const job = this.jobs.get(jobId);
     if (!job || job.status !== 'ready') {
-      return;
+      return Promise.resolve();
     }
 
-    job.status = 'building';
+    job.status = 'queued';
+    this.notify(job);
+
+    const queue = this.waiting.get(job.clientId);
+    if (queue) {
+      queue.push(jobId);
+    } else {
+      this.waiting.set(job.clientId, [jobId]);
+      this.clients.push(job.clientId);
+    }
+
+    const done = new Promise<void>((resolve, reject) => {
+      this.waiters.set(jobId, { resolve, reject });
+    });
+    this.dispatch();
+    return done;
+  }
+
+  // Starts waiting jobs while there are free slots, taking one job from each
+  // client in turn so a single client cannot starve the others
+  private dispatch() {
+    while (this.running < this.concurrency && this.clients.length > 0) {
+      const clientId = this.clients.shift()!;
+      const queue = this.waiting.get(clientId)!;
+      const jobId = queue.shift()!;
+      if (queue.length > 0) {
+        this.clients.push(clientId);
+      } else {
+        this.waiting.delete(clientId);
+      }
+
+      const job = this.jobs.get(jobId);
+      const waiter = this.waiters.get(jobId);
+      this.waiters.delete(jobId);
+      if (!job || !waiter) {
+        continue; // expired while waiting
+      }
+
+      this.running++;
+      this.runJob(job)
+        .then(waiter.resolve, waiter.reject)
+        .finally(() => {
+          this.running--;
+          this.dispatch();
+        });
+    }
+  }
+
+  private notify(job: Job) {
     job.updated = new Date();
+    this.emit(job.id, job);
+  }
+
+  // Takes build output as it arrives: remembers the last log line and
+  // reports STAGE lines. Chunks may end mid-line, so the tail is kept
+  private buildOutputHandler(job: Job): (text: string) => void {
+    let partial = '';
+    return (text) => {
+      const lines = (partial + text).split('\n');
+      partial = lines.pop()!;
+      for (const line of lines.map(line => line.trim()).filter(line => line !== '')) {
+        const stage = STAGE_LINE.exec(line);
+        if (stage) {
+          job.percent = Number(stage[1]);
+          job.stage = stage[2];
+          this.notify(job);
+        } else {
+          job.progress = line;
+          job.updated = new Date();
+        }
+      }
+    };
+  }
+
+  private async runJob(job: Job): Promise<void> {
+    const jobId = job.id;
+    job.status = 'building';
+    job.percent = 0;
+    this.notify(job);
     
     try {
       // Get the actual filename from the input directory
-      const jobInputDir = path.join(process.cwd(), 'temp', jobId, 'input');
+      const jobInputDir = path.join(process.cwd(), config.tempDir, jobId, 'input');
       const files = fs.readdirSync(jobInputDir);
       if (files.length === 0) {
         throw new Error('No input file found');
       }
       const actualSoundFontPath = path.join(jobInputDir, files[0]); // Use the first file found
       
-      const output = await triggerDockerBuild({
-        soundfontPath: actualSoundFontPath,
-        pluginName: job.pluginName,
-        jobId: job.id
-      });
+      const jobPluginsDir = path.join(process.cwd(), config.tempDir, jobId, 'plugins');
+      const zipPath = path.join(jobPluginsDir, `${job.pluginName}.zip`);
+      const cacheKey = await getCacheKey(actualSoundFontPath, job.pluginName, job.contentHash);
+
+      let output: string;
+      fs.mkdirSync(jobPluginsDir, { recursive: true });
+      if (cacheKey && fetchCached(cacheKey, zipPath)) {
+        console.log('Build cache hit:', cacheKey);
+        await verifyPlugin(jobPluginsDir, job.pluginName);
+        output = `Reused cached build ${cacheKey}\n`;
+      } else {
+        output = await triggerDockerBuild({
+          soundfontPath: actualSoundFontPath,
+          pluginName: job.pluginName,
+          jobId: job.id,
+          onOutput: this.buildOutputHandler(job)
+        });
+        if (cacheKey) {
+          storeCached(cacheKey, zipPath);
+        }
+      }
       
       job.status = 'complete';
       job.output = output;
-      job.updated = new Date();
+      job.percent = 100;
+      this.notify(job);
     } catch (error) {
       job.status = 'failed';
       job.error = error instanceof Error ? error.message : String(error);
-      job.updated = new Date();
+      this.notify(job);
       throw error; // Re-throw to propagate to the build route
     }
   }
@@ -106,25 +284,45 @@ export class BuildQueue {
   updateJob(jobId: string, updates: Partial<Job>): Job | undefined {
     const job = this.jobs.get(jobId);
     if (job) {
-      Object.assign(job, { ...updates, updated: new Date() });
-      this.jobs.set(jobId, job);
+      Object.assign(job, updates);
+      this.notify(job);
       return job;
     }
     return undefined;
   }
 
+  // Forgets finished jobs and uploads that were never built once they are
+  // older than their retention time, together with their temp directories,
+  // and removes temp entries that no longer belong to a job
   cleanup() {
-    const tempDir = path.join(process.cwd(), 'temp');
+    const now = Date.now();
+    const tempDir = path.join(process.cwd(), config.tempDir);
+
+    for (const [jobId, job] of this.jobs) {
+      if ((FINISHED.includes(job.status) || job.status === 'ready') && this.expired(job, now)) {
+        this.jobs.delete(jobId);
+        fs.rmSync(path.join(tempDir, jobId), { recursive: true, force: true });
+      }
+    }
+
     if (fs.existsSync(tempDir)) {
       const contents = fs.readdirSync(tempDir);
-      const now = Date.now();
       
       contents.forEach(item => {
         const itemPath = path.join(tempDir, item);
+        // The build cache has its own eviction, resumable uploads expire on
+        // their own and the builder pool queue is long-lived
+        if (item === config.buildCache.dir || item === config.uploads.dir ||
+            item === config.builderPool.dir) {
+          return;
+        }
+        if (this.jobs.has(item)) {
+          return;
+        }
         const stats = fs.statSync(itemPath);
         
-        // Remove items older than 1 hour
-        if (now - stats.mtimeMs > 3600000) {
+        // Remove orphaned items older than the retention time
+        if (now - stats.mtimeMs > config.queue.jobRetention) {
           if (stats.isDirectory()) {
             fs.rmSync(itemPath, { recursive: true, force: true });
           } else {
@@ -139,5 +337,5 @@ export class BuildQueue {
 // Export singleton instance
 export const buildQueue = new BuildQueue();
 
-// Run cleanup every hour
-setInterval(() => buildQueue.cleanup(), 60 * 60 * 1000); 
\ No newline at end of file
+// Expire old jobs periodically
+setInterval(() => buildQueue.cleanup(), config.cleanupInterval); 
\ No newline at end of file
@@ -0,0 +1,227 @@
+import crypto from 'crypto';
+import path from 'path';
+import fs from 'fs';
+import { Readable, Transform } from 'stream';
+import { pipeline } from 'stream/promises';
+import { Request } from 'express';
+import multer from 'multer';
+import { v4 as uuidv4 } from 'uuid';
+import { config } from '../config';
+
+// Streaming SoundFont uploads.
+//
+// Uploaded bytes go straight to disk; nothing holds a whole SoundFont in
+// memory. On the way through they are hashed (the build cache reuses the
+// sha256) and the RIFF header is checked, so a file that is not a SoundFont is
+// refused after its first 12 bytes instead of after the whole upload.
+//
+// Large files can be sent as a resumable upload: a session is created with
+// the file's name and size, the bytes are PUT in chunks at the session's
+// current offset, and a dropped chunk is resent from the offset the session
+// reports. Sessions live in <tempDir>/uploads until they are completed or go
+// idle for config.uploads.sessionTimeout.
+
+const uploadsDir = path.join(process.cwd(), config.tempDir, config.uploads.dir);
+
+export class InvalidUploadError extends Error {
+  constructor(message: string) {
+    super(message);
+    this.name = 'InvalidUploadError';
+  }
+}
+
+// Incremental sha256 and RIFF sfbk header check of an upload
+export class UploadDigest {
+  private hash = crypto.createHash('sha256');
+  private header = Buffer.alloc(0);
+  bytes = 0;
+
+  update(chunk: Buffer) {
+    if (this.header.length < 12) {
+      this.header = Buffer.concat([this.header, chunk.subarray(0, 12 - this.header.length)]);
+      if (this.header.length === 12 &&
+          (this.header.toString('latin1', 0, 4) !== 'RIFF' || this.header.toString('latin1', 8, 12) !== 'sfbk')) {
+        throw new InvalidUploadError('Not a SoundFont file (missing RIFF sfbk header)');
+      }
+    }
+    this.hash.update(chunk);
+    this.bytes += chunk.length;
+  }
+
+  // A copy to roll back to if the next chunk fails part way
+  checkpoint(): UploadDigest {
+    const copy = new UploadDigest();
+    copy.hash = this.hash.copy();
+    copy.header = this.header;
+    copy.bytes = this.bytes;
+    return copy;
+  }
+
+  digest(): string {
+    if (this.header.length < 12) {
+      throw new InvalidUploadError('File is too short to be a SoundFont');
+    }
+    return this.hash.digest('hex');
+  }
+}
+
+// Writes source to filePath at offset, feeding the digest. Fails with
+// InvalidUploadError when the data is not a SoundFont or more than maxBytes
+// arrive.
+export async function writeUpload(source: Readable, filePath: string, offset: number,
+                                  digest: UploadDigest, maxBytes: number): Promise<void> {
+  const limit = digest.bytes + maxBytes;
+  const inspect = new Transform({
+    transform(chunk: Buffer, _encoding, callback) {
+      try {
+        if (digest.bytes + chunk.length > limit) {
+          throw new InvalidUploadError('Upload is larger than expected');
+        }
+        digest.update(chunk);
+        callback(null, chunk);
+      } catch (error) {
+        callback(error as Error);
+      }
+    }
+  });
+  const target = fs.createWriteStream(filePath, { flags: offset > 0 ? 'r+' : 'w', start: offset });
+  await pipeline(source, inspect, target);
+}
+
+// Multer storage engine writing the file to the path given by target(req)
+// while digesting it. The file's sha256 is reported as `sha256`.
+export function soundFontStorage(target: (req: Request) => string): multer.StorageEngine {
+  return {
+    _handleFile(req, file, callback) {
+      const filePath = target(req);
+      const digest = new UploadDigest();
+      writeUpload(file.stream, filePath, 0, digest, config.uploadLimits.fileSize)
+        .then(() => {
+          const info: Partial<Express.Multer.File> & { sha256: string } = {
+            path: filePath,
+            size: digest.bytes,
+            sha256: digest.digest()
+          };
+          callback(null, info);
+        })
+        .catch(error => {
+          fs.rm(filePath, { force: true }, () => callback(error));
+        });
+    },
+    _removeFile(_req, file, callback) {
+      fs.rm(file.path, { force: true }, callback);
+    }
+  };
+}
+
+export interface UploadSession {
+  id: string;
+  clientId: string; // who started it, for the per-client session limit
+  fileName: string;
+  size: number;
+  offset: number; // bytes received so far
+  filePath: string;
+  digest: UploadDigest;
+  busy: boolean; // a chunk is being received
+  updated: number;
+}
+
+const sessions = new Map<string, UploadSession>();
+
+// Open sessions of a client; each one can take up to a full file on disk
+export function countSessions(clientId: string): number {
+  let count = 0;
+  for (const session of sessions.values()) {
+    if (session.clientId === clientId) {
+      count++;
+    }
+  }
+  return count;
+}
+
+export function createSession(fileName: string, size: number, clientId: string): UploadSession {
+  fs.mkdirSync(uploadsDir, { recursive: true });
+  const id = uuidv4();
+  const session: UploadSession = {
+    id,
+    clientId,
+    fileName,
+    size,
+    offset: 0,
+    filePath: path.join(uploadsDir, `${id}.part`),
+    digest: new UploadDigest(),
+    busy: false,
+    updated: Date.now()
+  };
+  fs.writeFileSync(session.filePath, '');
+  sessions.set(id, session);
+  return session;
+}
+
+export function getSession(id: string): UploadSession | undefined {
+  return sessions.get(id);
+}
+
+// Appends one chunk at the session's offset. A failed chunk is undone (the
+// file is truncated and the digest rolled back), so it can simply be resent.
+export async function receiveChunk(session: UploadSession, source: Readable): Promise<void> {
+  const checkpoint = session.digest.checkpoint();
+  const maxBytes = Math.min(config.uploads.chunkSize, session.size - session.offset);
+  session.busy = true;
+  session.updated = Date.now();
+  try {
+    await writeUpload(source, session.filePath, session.offset, session.digest, maxBytes);
+    session.offset = session.digest.bytes;
+  } catch (error) {
+    session.digest = checkpoint;
+    await fs.promises.truncate(session.filePath, session.offset).catch(() => undefined);
+    throw error;
+  } finally {
+    session.busy = false;
+    session.updated = Date.now();
+  }
+}
+
+// Ends a fully received session: moves the file to targetPath and returns
+// its sha256
+export function completeSession(session: UploadSession, targetPath: string): string {
+  if (session.offset !== session.size) {
+    throw new InvalidUploadError(`Upload incomplete: ${session.offset} of ${session.size} bytes received`);
+  }
+  const sha256 = session.digest.digest();
+  fs.renameSync(session.filePath, targetPath);
+  sessions.delete(session.id);
+  return sha256;
+}
+
+export function dropSession(session: UploadSession) {
+  sessions.delete(session.id);
+  fs.rmSync(session.filePath, { force: true });
+}
+
+// Drops idle sessions and partial files left behind by a restart
+function expireSessions() {
+  const now = Date.now();
+  for (const session of sessions.values()) {
+    if (!session.busy && now - session.updated > config.uploads.sessionTimeout) {
+      console.log('Upload session expired:', session.id, session.fileName);
+      dropSession(session);
+    }
+  }
+
+  if (!fs.existsSync(uploadsDir)) {
+    return;
+  }
+  for (const item of fs.readdirSync(uploadsDir)) {
+    const itemPath = path.join(uploadsDir, item);
+    if (sessions.has(path.basename(item, '.part'))) {
+      continue;
+    }
+    const stats = fs.statSync(itemPath);
+    if (now - stats.mtimeMs > config.uploads.sessionTimeout) {
+      fs.rmSync(itemPath, { recursive: true, force: true });
+    }
+  }
+}
+
+setInterval(expireSessions, config.cleanupInterval);
@@ -0,0 +1,48 @@
+import fs from 'fs';
+import { execFile } from 'child_process';
+import { config } from '../config';
+
+export interface ValidationResult {
+  valid: boolean;
+  error?: string;
+}
+
+let warnedMissing = false;
+
+// Runs the native SoundFont validator (sf2lv2/src/sf2_validate.c) on an
+// uploaded file. It only reads the RIFF structure and preset tables, so it
+// finishes in milliseconds. Without a validator binary uploads are accepted
+// and a bad file is only caught by the build.
+export function validateSoundFont(soundfontPath: string): Promise<ValidationResult> {
+  const validator = config.validator.path;
+
+  if (!fs.existsSync(validator)) {
+    if (!warnedMissing) {
+      console.warn(`SoundFont validator not found at ${validator}, skipping validation (run "make validator" in sf2lv2)`);
+      warnedMissing = true;
+    }
+    return Promise.resolve({ valid: true });
+  }
+
+  return new Promise((resolve) => {
+    execFile(validator, [soundfontPath], { timeout: config.validator.timeout }, (error, stdout, stderr) => {
+      if (!error) {
+        console.log('SoundFont validator:', stdout.trim());
+        if (stderr.trim()) {
+          console.warn('SoundFont validator:', stderr.trim());
+        }
+        resolve({ valid: true });
+        return;
+      }
+
+      // Exit status 1 means the file is invalid; anything else (I/O error,
+      // timeout, crash) is a validator problem and should not block the upload
+      if (error.code === 1) {
+        resolve({ valid: false, error: stderr.trim().replace(/^Invalid SoundFont: /, '') });
+      } else {
+        console.error('SoundFont validator failed:', error, stderr);
+        resolve({ valid: true });
+      }
+    });
+  });
+}
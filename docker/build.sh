@@ -5,6 +5,96 @@ log() {
     echo "[$(date '+%Y-%m-%d %H:%M:%S')] $1"
 }
 
+# Report a build stage to the backend as "STAGE <percent> <name>"; stages:
+# prepare, compile, copy, metadata, verify, zip, done
+stage() {
+    echo "STAGE $1 $2"
+}
+
+# Pass make's output through, adding stage lines for the steps it runs
+report_make_stages() {
+    while IFS= read -r line; do
+        echo "$line"
+        case "$line" in
+            "Building plugin runtime..."*|"Building metadata generator..."*|"Building SoundFont subsetter..."*)
+                stage 20 compile ;;
+            "Copying plugin binary..."*)
+                stage 30 copy ;;
+            "Copying SoundFont and generating metadata..."*)
+                stage 40 metadata ;;
+        esac
+    done
+}
+
+# Run make in the sf2lv2 directory with the AARCH64 cross-compilation settings.
+# The image prebuilds the plugin runtime with these same settings, so plugin
+# builds only copy it instead of compiling it again
+run_make() {
+    make -C /build/sf2lv2 "$@" \
+        CROSS_COMPILE=aarch64-linux-gnu- \
+        CC=${CROSS_COMPILE}gcc \
+        CFLAGS="-I/usr/aarch64-linux-gnu/include -DSF2_FILE=\\\"soundfont.sf2\\\"" \
+        LDFLAGS="-L/usr/aarch64-linux-gnu/lib -lfluidsynth"
+}
+
+# Prebuild the plugin runtime and metadata generator (run once when the image is built)
+if [ "$1" = "--prebuild" ]; then
+    log "Prebuilding plugin runtime and tools for AARCH64..."
+    run_make runtime tools
+    exit $?
+fi
+
+# Worker mode: stay up and build jobs handed over through <jobs root>/pool.
+# The backend drops a ticket named after the job id (holding the plugin name)
+# into pool/pending; a worker claims it by renaming it into pool/active, which
+# only one worker can win. Each job builds from <jobs root>/<job id>/input into
+# <jobs root>/<job id>/plugins, records the worker's name in build.worker,
+# logs to build.log there and records its exit status in build.exit. The
+# prebuilt runtime and tools stay warm across jobs.
+if [ "$1" = "--worker" ]; then
+    JOBS_ROOT="${2:-/jobs}"
+    WORKER_ID="${3:-$(hostname)}"
+    QUEUE_DIR="${JOBS_ROOT}/pool"
+    mkdir -p "${QUEUE_DIR}/pending" "${QUEUE_DIR}/active"
+    log "Worker ${WORKER_ID} waiting for jobs in ${QUEUE_DIR}"
+
+    while true; do
+        CLAIMED=""
+        for TICKET in "${QUEUE_DIR}"/pending/*; do
+            [ -f "$TICKET" ] || continue
+            JOB_ID=$(basename "$TICKET")
+            if mv "$TICKET" "${QUEUE_DIR}/active/${JOB_ID}" 2>/dev/null; then
+                CLAIMED="${QUEUE_DIR}/active/${JOB_ID}"
+                break
+            fi
+        done
+
+        if [ -z "$CLAIMED" ]; then
+            sleep 0.2
+            continue
+        fi
+
+        JOB_NAME=$(head -n 1 "$CLAIMED")
+        JOB_DIR="${JOBS_ROOT}/${JOB_ID}"
+        log "Worker ${WORKER_ID} building job ${JOB_ID} (${JOB_NAME})"
+
+        echo "$WORKER_ID" > "${JOB_DIR}/build.worker"
+        mkdir -p "${JOB_DIR}/plugins"
+        INPUT_DIR="${JOB_DIR}/input" OUTPUT_DIR="${JOB_DIR}/plugins" \
+            "$0" soundfont.sf2 "$JOB_NAME" > "${JOB_DIR}/build.log" 2>&1
+        STATUS=$?
+
+        # The zip is all that is kept; drop the bundle so the worker does not
+        # accumulate SoundFonts
+        rm -rf "/build/sf2lv2/build/${JOB_NAME}.lv2"
+
+        echo "$STATUS" > "${JOB_DIR}/build.exit.tmp"
+        mv "${JOB_DIR}/build.exit.tmp" "${JOB_DIR}/build.exit"
+        rm -f "$CLAIMED"
+        log "Worker ${WORKER_ID} finished job ${JOB_ID} with status ${STATUS}"
+    done
+fi
+
 # Check arguments
 if [ "$#" -ne 2 ]; then
     log "Error: Incorrect number of arguments"
@@ -15,93 +105,66 @@ fi
 SF2_FILE="$1"
 PLUGIN_NAME="$2"
 
-# Verify input file exists
-if [ ! -f "/input/$SF2_FILE" ]; then
-    log "Error: Input file /input/$SF2_FILE not found"
-    ls -la /input/
-    exit 1
-fi
-
-# Create plugin directory structure with clean paths
-log "Creating plugin directory structure..."
-mkdir -p "/build/${PLUGIN_NAME}.lv2"
-
-# Define consistent plugin directory path - avoid any double slashes
-PLUGIN_DIR="/build/${PLUGIN_NAME}.lv2"
-
-# Create sf2lv2 build directory too - important for the build process
-mkdir -p "/build/sf2lv2/build/${PLUGIN_NAME}.lv2"
-SF2LV2_PLUGIN_DIR="/build/sf2lv2/build/${PLUGIN_NAME}.lv2"
+# Job directories; one-shot containers mount them at /input and /output
+INPUT_DIR="${INPUT_DIR:-/input}"
+OUTPUT_DIR="${OUTPUT_DIR:-/output}"
 
-# Copy soundfont file to both locations to ensure it's found
-log "Copying soundfont file to plugin directories..."
-cp "/input/$SF2_FILE" "${PLUGIN_DIR}/soundfont.sf2" 
-cp "/input/$SF2_FILE" "${SF2LV2_PLUGIN_DIR}/soundfont.sf2"
-# Also copy to sf2lv2 directory for build process
-cp "/input/$SF2_FILE" "/build/sf2lv2/soundfont.sf2"
-
-# Verify the soundfont was copied correctly
-if [ ! -f "${PLUGIN_DIR}/soundfont.sf2" ]; then
-    log "Error: Failed to copy soundfont file to ${PLUGIN_DIR}"
-    exit 1
-fi
-
-if [ ! -f "${SF2LV2_PLUGIN_DIR}/soundfont.sf2" ]; then
-    log "Error: Failed to copy soundfont file to ${SF2LV2_PLUGIN_DIR}"
+# Verify input file exists
+if [ ! -f "${INPUT_DIR}/$SF2_FILE" ]; then
+    log "Error: Input file ${INPUT_DIR}/$SF2_FILE not found"
+    ls -la "${INPUT_DIR}/"
     exit 1
 fi
 
-# Log the directories for debugging
-log "Directory structure:"
-ls -la /build/
-ls -la "${PLUGIN_DIR}"
-ls -la "/build/sf2lv2"
-ls -la "${SF2LV2_PLUGIN_DIR}" || echo "SF2LV2 plugin directory not yet created"
+# The bundle is built in one place, the sf2lv2 build directory; the metadata
+# generator links (or, across file systems, kernel-copies) the SoundFont
+# straight from the input into it
+PLUGIN_DIR="/build/sf2lv2/build/${PLUGIN_NAME}.lv2"
 
 # Build the plugin
+stage 5 prepare
 log "Building plugin for AARCH64..."
 cd /build/sf2lv2
 
-# Clean any previous builds
-make clean
+# Clean any previous build of this plugin, keeping the prebuilt runtime
+make clean_plugin PLUGIN_NAME="$PLUGIN_NAME"
 
 # Debug: Echo important variables
-log "Debug: SF2_FILE = ${SF2_FILE}"
+log "Debug: SF2_FILE = ${INPUT_DIR}/${SF2_FILE}"
 log "Debug: PLUGIN_NAME = ${PLUGIN_NAME}"
 
-# Build directly with build_plugin target
-# Set a fixed soundfont filename "soundfont.sf2" rather than using the timestamped name
-make build_plugin \
-    CROSS_COMPILE=aarch64-linux-gnu- \
-    CC=${CROSS_COMPILE}gcc \
+# Build directly with build_plugin target. With SUBSET=1 unused instruments,
+# samples and 24-bit data are stripped from the bundled SoundFont; the
+# subsetter only reads plain SF2, so SF3 uploads (ifil major version 3, right
+# after the RIFF and INFO headers) are always bundled as they are
+SUBSET="${SUBSET:-0}"
+if [ "$SUBSET" = "1" ] && [ "$(od -An -tu2 -j32 -N2 "${INPUT_DIR}/${SF2_FILE}" | tr -d ' ')" = "3" ]; then
+    log "SoundFont is SF3, skipping the subset"
+    SUBSET=0
+fi
+run_make build_plugin \
     PLUGIN_NAME="$PLUGIN_NAME" \
-    SF2_FILE="soundfont.sf2" \
-    CFLAGS="-I/usr/aarch64-linux-gnu/include -DSF2_FILE=\\\"soundfont.sf2\\\"" \
-    LDFLAGS="-L/usr/aarch64-linux-gnu/lib -lfluidsynth" || {
+    SF2_FILE="${INPUT_DIR}/${SF2_FILE}" \
+    SUBSET="$SUBSET" 2>&1 | report_make_stages
+if [ "${PIPESTATUS[0]}" -ne 0 ]; then
     log "Error: Build failed"
     exit 1
-}
+fi
 
 # Verify plugin was built
-if [ ! -d "${SF2LV2_PLUGIN_DIR}" ]; then
+if [ ! -d "${PLUGIN_DIR}" ]; then
     log "Error: Plugin directory not created by build"
     exit 1
 fi
 
 # Check the plugin binary for SF2_FILE definition
 log "Checking plugin binary for SF2_FILE definition:"
-strings "${SF2LV2_PLUGIN_DIR}/${PLUGIN_NAME}.so" | grep -E 'SF2_FILE|undefined|soundfont' || {
+strings "${PLUGIN_DIR}/${PLUGIN_NAME}.so" | grep -E 'SF2_FILE|undefined|soundfont' || {
     log "Warning: Could not find SF2_FILE string in plugin binary"
 }
 
-# Copy all plugin files from SF2LV2 build directory to main plugin directory
-log "Copying plugin files from sf2lv2 build directory to main plugin directory..."
-cp -r "${SF2LV2_PLUGIN_DIR}"/* "${PLUGIN_DIR}/" || {
-    log "Error: Failed to copy plugin files"
-    exit 1
-}
-
 # Verify essential plugin files exist
+stage 75 verify
 log "Verifying essential plugin files..."
 MISSING_FILES=0
 
@@ -111,7 +174,11 @@ if [ ! -f "${PLUGIN_DIR}/${PLUGIN_NAME}.so" ]; then
     MISSING_FILES=1
 fi
 
-# Check for TTL files
+# Check for TTL files and the bundle descriptor
+if [ ! -f "${PLUGIN_DIR}/plugin.desc" ]; then
+    log "Error: plugin.desc not found in plugin directory"
+    MISSING_FILES=1
+fi
 if [ ! -f "${PLUGIN_DIR}/manifest.ttl" ]; then
     log "Error: manifest.ttl not found in plugin directory"
     MISSING_FILES=1
@@ -142,20 +209,24 @@ find /build -name "*.zip" | xargs -r ls -la
 log "Detailed listing of the plugin directory structure:"
 find "${PLUGIN_DIR}" -type f | sort
 
-# Create zip file
+# Create zip file; sample data barely compresses, so the SoundFont is stored
+# rather than deflated
+stage 85 zip
 log "Creating zip archive..."
-cd /build
-zip -r "/output/${PLUGIN_NAME}.zip" "${PLUGIN_NAME}.lv2" || {
+cd /build/sf2lv2/build
+rm -f "${OUTPUT_DIR}/${PLUGIN_NAME}.zip"
+zip -r -n .sf2:.sf3 "${OUTPUT_DIR}/${PLUGIN_NAME}.zip" "${PLUGIN_NAME}.lv2" || {
     log "Error: Failed to create zip archive"
     exit 1
 }
 
 # Also debug the contents of the zip file
 log "Zip file contents:"
-unzip -l "/output/${PLUGIN_NAME}.zip"
+unzip -l "${OUTPUT_DIR}/${PLUGIN_NAME}.zip"
 
+stage 100 done
 log "Build completed successfully"
-log "Plugin has been saved to /output/${PLUGIN_NAME}.zip"
+log "Plugin has been saved to ${OUTPUT_DIR}/${PLUGIN_NAME}.zip"
 
 # This script likely handles:
 # 1. Mounting the soundfont file
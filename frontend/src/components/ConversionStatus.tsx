@@ -5,6 +5,7 @@ import '../styles/ConversionStatus.css';
 interface ConversionStatusProps {
   status: Status;
   progress: number;
+  stage?: string; // build stage while building
   error?: string;
   onRetry?: () => void;
   onCreatePlugin?: () => void;
@@ -20,21 +21,34 @@ const statusMessages: Record<Status, string> = {
   building: 'Building LV2 plugin...',
   packaging: 'Packaging plugin files...',
   ready: 'Ready to create LV2 plugin',
+  queued: 'Waiting for a free builder...',
   complete: 'Plugin ready for download!',
   failed: 'Build process failed',
   error: 'Conversion failed'
 };
 
+// Messages for the build stages reported while building
+const stageMessages: Record<string, string> = {
+  prepare: 'Preparing build...',
+  compile: 'Compiling plugin...',
+  copy: 'Copying plugin binary...',
+  metadata: 'Generating plugin metadata...',
+  verify: 'Verifying plugin files...',
+  zip: 'Packaging plugin files...',
+  done: 'Finishing build...'
+};
+
 export function ConversionStatus({ 
   status, 
   progress, 
+  stage,
   error, 
   onRetry,
   onCreatePlugin,
   onDownload,
   pluginUrl 
 }: ConversionStatusProps) {
-  const isProcessing = ['uploading', 'validating', 'building', 'packaging'].includes(status);
+  const isProcessing = ['uploading', 'validating', 'queued', 'building', 'packaging'].includes(status);
   const showProgress = isProcessing;
   const showCreateButton = status === 'ready';
   const showDownloadButton = status === 'complete' && pluginUrl;
@@ -44,7 +58,7 @@ export function ConversionStatus({
   return (
     <div className="conversion-status">
       <div className="status-header">
-        <h3>{statusMessages[status]}</h3>
+        <h3>{(status === 'building' && stage && stageMessages[stage]) || statusMessages[status]}</h3>
         {status === 'error' && onRetry && (
           <button onClick={onRetry} className="retry-button">
             Try Again
@@ -9,6 +9,126 @@ import '../styles/FileUpload.css';
 
 const API_BASE = '/api';
 
+// Files above this size are sent as a resumable, chunked upload
+const RESUMABLE_THRESHOLD = 32 * 1024 * 1024;
+const CHUNK_RETRIES = 5;
+
+class UploadRequestError extends Error {
+  constructor(message: string, public status: number, public response?: any) {
+    super(message);
+  }
+}
+
+// Turn a failed upload response into a message for the user
+function uploadErrorMessage(status: number, response: any, statusText: string): string {
+  if (status === 400 && response?.details) {
+    // Rejected by the SoundFont checks
+    return `${response.error}: ${response.details}`;
+  }
+  if (status === 503) {
+    return 'The build queue is full, please try again in a moment';
+  }
+  return `Upload failed: ${response?.error || statusText}`;
+}
+
+// Send one upload request, reporting the bytes sent so far
+function sendUploadRequest(method: string, url: string, body: XMLHttpRequestBodyInit | null,
+                           onProgress?: (loaded: number) => void, contentType?: string): Promise<any> {
+  return new Promise((resolve, reject) => {
+    const xhr = new XMLHttpRequest();
+
+    // Setup upload progress handler
+    xhr.upload.onprogress = (event) => {
+      if (onProgress) {
+        onProgress(event.loaded);
+      }
+    };
+
+    // Setup completion handler
+    xhr.onload = () => {
+      let response: any;
+      try {
+        response = JSON.parse(xhr.responseText);
+      } catch {
+        response = undefined;
+      }
+      if (xhr.status >= 200 && xhr.status < 300 && response) {
+        resolve(response);
+        return;
+      }
+      console.error('Upload request failed:', {
+        status: xhr.status,
+        statusText: xhr.statusText,
+        response: xhr.responseText
+      });
+      reject(new UploadRequestError(uploadErrorMessage(xhr.status, response, xhr.statusText), xhr.status, response));
+    };
+
+    // Setup error handler
+    xhr.onerror = () => {
+      console.error('Network error during upload');
+      reject(new UploadRequestError('Network error during upload', 0));
+    };
+
+    // Setup timeout handler
+    xhr.ontimeout = () => {
+      console.error('Upload timed out');
+      reject(new UploadRequestError('Upload timed out', 0));
+    };
+
+    xhr.open(method, url);
+    xhr.timeout = 60000; // 60 seconds timeout
+    if (contentType) {
+      xhr.setRequestHeader('Content-Type', contentType);
+    }
+    xhr.send(body);
+  });
+}
+
+// Upload the file in a single multipart request
+function uploadForm(file: File, setProgress: (percent: number) => void): Promise<any> {
+  const formData = new FormData();
+  formData.append('file', file, file.name);
+  console.log('Sending upload request...');
+  return sendUploadRequest('POST', `${API_BASE}/upload`, formData,
+    (loaded) => setProgress(Math.round((loaded / file.size) * 100)));
+}
+
+// Upload the file in chunks through an upload session. A failed chunk is
+// retried from the offset the server has, so a dropped connection only
+// costs the chunk in flight
+async function uploadResumable(file: File, setProgress: (percent: number) => void): Promise<any> {
+  const json = 'application/json';
+  const session = await sendUploadRequest('POST', `${API_BASE}/upload/sessions`,
+    JSON.stringify({ fileName: file.name, size: file.size }), undefined, json);
+  const sessionUrl = `${API_BASE}/upload/sessions/${session.uploadId}`;
+  console.log('Started resumable upload:', session.uploadId);
+
+  let offset: number = session.offset;
+  let failures = 0;
+  while (offset < file.size) {
+    const chunk = file.slice(offset, offset + session.chunkSize);
+    try {
+      const result = await sendUploadRequest('PUT', `${sessionUrl}?offset=${offset}`, chunk,
+        (loaded) => setProgress(Math.round(((offset + loaded) / file.size) * 100)),
+        'application/octet-stream');
+      offset = result.offset;
+      failures = 0;
+    } catch (error) {
+      const status = error instanceof UploadRequestError ? error.status : 0;
+      if ((status !== 0 && status !== 409 && status < 500) || ++failures > CHUNK_RETRIES) {
+        throw error;
+      }
+      console.warn(`Chunk at ${offset} failed, resuming (attempt ${failures})`, error);
+      await new Promise(resolve => setTimeout(resolve, 1000 * failures));
+      const state = await sendUploadRequest('GET', sessionUrl, null);
+      offset = state.offset;
+    }
+  }
+
+  return sendUploadRequest('POST', `${sessionUrl}/complete`, null);
+}
+
 function extractGlobalValues(_preset: BasicPreset): PresetGlobalValues {
     // Return empty object since we're not using these values anymore
     return {};
@@ -25,7 +145,7 @@ const FileUpload: React.FC = () => {
   const [uploadedFilePath, setUploadedFilePath] = useState<string>();
   
   // Use our job status hook for build progress
-  const { status: buildStatus, progress: buildProgress, error: buildError, pluginUrl } = useJobStatus(jobId);
+  const { status: buildStatus, stage: buildStage, progress: buildProgress, error: buildError, pluginUrl } = useJobStatus(jobId);
 
   const handleFileUpload = async (file: File) => {
     try {
@@ -33,67 +153,13 @@ const FileUpload: React.FC = () => {
       setUploadProgress(0);
       console.log('Starting file upload...', file.name, file.size);
       
-      // First read the file into memory
+      // Read the file for the local preview; the upload itself streams it
       const arrayBuffer = await file.arrayBuffer();
-      const formData = new FormData();
-      
-      // Create a new Blob with the file data
-      const blob = new Blob([arrayBuffer], { type: file.type });
-      formData.append('file', blob, file.name);
-      
-      return new Promise((resolve, reject) => {
-        const xhr = new XMLHttpRequest();
-        
-        // Setup upload progress handler
-        xhr.upload.onprogress = (event) => {
-          if (event.lengthComputable) {
-            const percentComplete = (event.loaded / event.total) * 100;
-            console.log(`Upload progress: ${percentComplete.toFixed(2)}% (${event.loaded}/${event.total} bytes)`);
-            setUploadProgress(Math.round(percentComplete));
-          }
-        };
-
-        // Setup completion handler
-        xhr.onload = () => {
-          if (xhr.status >= 200 && xhr.status < 300) {
-            console.log('Upload completed successfully');
-            try {
-              const response = JSON.parse(xhr.responseText);
-              resolve(response);
-            } catch (error) {
-              console.error('Error parsing response:', error);
-              reject(new Error('Invalid response from server'));
-            }
-          } else {
-            console.error('Upload failed:', {
-              status: xhr.status,
-              statusText: xhr.statusText,
-              response: xhr.responseText
-            });
-            reject(new Error(`Upload failed: ${xhr.statusText}`));
-          }
-        };
-
-        // Setup error handler
-        xhr.onerror = () => {
-          console.error('Network error during upload');
-          reject(new Error('Network error during upload'));
-        };
-
-        // Setup timeout handler
-        xhr.ontimeout = () => {
-          console.error('Upload timed out');
-          reject(new Error('Upload timed out'));
-        };
-
-        // Configure request with relative URL
-        xhr.open('POST', `${API_BASE}/upload`);
-        xhr.timeout = 60000; // 60 seconds timeout
-        
-        // Send the request
-        console.log('Sending upload request...');
-        xhr.send(formData);
-      }).then(async (response: any) => {
+
+      return (file.size > RESUMABLE_THRESHOLD
+        ? uploadResumable(file, setUploadProgress)
+        : uploadForm(file, setUploadProgress)
+      ).then(async (response: any) => {
         console.log('Upload successful, processing file locally...', response);
         setUploadedFilePath(response.file.path);
         setJobId(response.job.id);
@@ -246,6 +312,7 @@ const FileUpload: React.FC = () => {
           <ConversionStatus
             status={conversionStatus}
             progress={conversionProgress}
+            stage={jobId ? buildStage : undefined}
             error={conversionError}
             onRetry={handleRetry}
             onCreatePlugin={conversionStatus === 'ready' ? handleCreatePlugin : undefined}
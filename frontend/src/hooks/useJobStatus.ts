@@ -6,10 +6,38 @@ interface JobStatus {
   status: ConversionStatus;
   error?: string;
   output?: string;
+  stage?: string; // build stage while building
+  percent?: number; // build progress, 0-100
 }
 
+const FINISHED: ConversionStatus[] = ['complete', 'failed', 'error'];
+
+// Map a job update to the overall progress shown; the build itself takes
+// the range from 60 to 100
+function progressFor(data: JobStatus): number {
+  switch (data.status) {
+    case 'uploading':
+      return 25;
+    case 'validating':
+      return 50;
+    case 'queued':
+      return 60;
+    case 'building':
+      return data.percent !== undefined ? 60 + Math.round(data.percent * 0.4) : 75;
+    case 'packaging':
+      return 90;
+    case 'complete':
+      return 100;
+    default:
+      return 0;
+  }
+}
+
+// Follows a job through the server-sent events stream of its status. If the
+// stream cannot be opened (or breaks), falls back to polling every 2 seconds.
 export function useJobStatus(jobId?: string) {
   const [status, setStatus] = useState<ConversionStatus>('idle');
+  const [stage, setStage] = useState<string>();
   const [progress, setProgress] = useState(0);
   const [error, setError] = useState<string>();
   const [pluginUrl, setPluginUrl] = useState<string>();
@@ -17,64 +45,65 @@ export function useJobStatus(jobId?: string) {
   useEffect(() => {
     if (!jobId) return;
 
+    let source: EventSource | undefined;
+    let interval: ReturnType<typeof setInterval> | undefined;
+    let finished = false;
+
+    const apply = (data: JobStatus) => {
+      setStatus(data.status);
+      setStage(data.stage);
+      setError(data.error);
+      setProgress(progressFor(data));
+
+      if (data.status === 'complete') {
+        // When complete, set the plugin URL
+        setPluginUrl(`/api/download/${jobId}`);
+      }
+      if (FINISHED.includes(data.status)) {
+        finished = true;
+        source?.close();
+        clearInterval(interval);
+      }
+    };
+
     const pollStatus = async () => {
       try {
         const response = await fetch(`/api/upload/status/${jobId}`);
         if (!response.ok) {
           throw new Error('Failed to fetch job status');
         }
-        
-        const data: JobStatus = await response.json();
-        setStatus(data.status);
-        setError(data.error);
-
-        // Calculate progress based on status
-        switch (data.status) {
-          case 'uploading':
-            setProgress(25);
-            break;
-          case 'validating':
-            setProgress(50);
-            break;
-          case 'building':
-            setProgress(75);
-            break;
-          case 'packaging':
-            setProgress(90);
-            break;
-          case 'complete':
-            setProgress(100);
-            // When complete, set the plugin URL
-            if (data.output) {
-              setPluginUrl(`/api/download/${jobId}`);
-            }
-            break;
-          case 'error':
-            setProgress(0);
-            break;
-          default:
-            setProgress(0);
-        }
+        apply(await response.json());
       } catch (err) {
         setError(err instanceof Error ? err.message : 'Failed to fetch status');
         setStatus('error');
+        finished = true;
+        clearInterval(interval);
       }
     };
 
-    // Poll every 2 seconds while job is in progress
-    const interval = setInterval(() => {
-      if (['complete', 'error'].includes(status)) {
-        clearInterval(interval);
-        return;
-      }
+    const startPolling = () => {
+      if (interval || finished) return;
       pollStatus();
-    }, 2000);
+      interval = setInterval(pollStatus, 2000);
+    };
 
-    // Initial poll
-    pollStatus();
+    if (typeof EventSource !== 'undefined') {
+      source = new EventSource(`/api/upload/status/${jobId}/events`);
+      source.onmessage = (event) => apply(JSON.parse(event.data));
+      source.onerror = () => {
+        // The server also closes the stream once the job has finished
+        source?.close();
+        startPolling();
+      };
+    } else {
+      startPolling();
+    }
 
-    return () => clearInterval(interval);
-  }, [jobId, status]);
+    return () => {
+      source?.close();
+      clearInterval(interval);
+    };
+  }, [jobId]);
 
   const handleRetry = async () => {
     if (!jobId) return;
@@ -85,9 +114,10 @@ export function useJobStatus(jobId?: string) {
 
   return {
     status,
+    stage,
     progress,
     error,
     pluginUrl,
     retry: handleRetry
   };
-} 
\ No newline at end of file
+}
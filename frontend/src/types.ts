@@ -9,6 +9,7 @@ export type ConversionStatus =
   | 'building'
   | 'packaging'
   | 'ready'
+  | 'queued'
   | 'complete'
   | 'failed'
   | 'error';
@@ -0,0 +1,471 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Offline Benchmark (bench.c)
+ *
+ * Measures the cost of a built plugin without an LV2 host or audio hardware:
+ * 1. Loads the plugin binary and its descriptor through lv2_lib_descriptor(),
+ *    or lv2_descriptor() for binaries without it
+ * 2. Provides the host features it uses (URID map, a synchronous worker and
+ *    instantiation options)
+ * 3. Plays a scripted MIDI sequence through run() - chords, fast arpeggios,
+ *    CC sweeps, pitch bends and program changes
+ * 4. Reports render cost per sample, the worst block and resident memory
+ *
+ * Usage: bench <plugin.so> <bundle dir> [-b block size] [-r sample rate]
+ *              [-s seconds] [-p polyphony]
+ */
+
+#include <lv2/core/lv2.h>
+#include <lv2/atom/atom.h>
+#include <lv2/atom/util.h>
+#include <lv2/midi/midi.h>
+#include <lv2/urid/urid.h>
+#include <lv2/worker/worker.h>
+#include <lv2/options/options.h>
+
+#include "preset_index.h"
+#include "plugin_uris.h"
+
+#include <dlfcn.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Ports 0-10 are fixed (see synth_plugin.c). Every index above the control
+   ports is connected to a scratch buffer, so optional output ports are
+   covered whatever the plugin was built with; the plugin ignores indices it
+   does not have */
+#define PORT_EVENTS    0
+#define PORT_LEVEL     3
+#define PORT_PROGRAM   4
+#define PORT_CUTOFF    5
+#define MAX_PORTS      64
+
+#define EVENT_BUFFER_SIZE 65536   // Bytes of atom sequence per block
+#define MAX_RESPONSES     16      // Worker responses queued during one run()
+#define MAX_RESPONSE_SIZE 64      // Bytes per worker response
+#define PROGRAM_INTERVAL  4.0     // Seconds between program changes
+
+/* One MIDI message of the benchmark script */
+typedef struct {
+    uint64_t frame;     // Absolute frame at which the message is sent
+    uint8_t msg[3];     // MIDI bytes
+} ScriptEvent;
+
+/* Growable list of script events */
+typedef struct {
+    ScriptEvent* events;
+    size_t count;
+    size_t capacity;
+} Script;
+
+/* Host-side URID map: URIs are numbered in the order they are first seen */
+typedef struct {
+    char** uris;
+    uint32_t count;
+} UridTable;
+
+/* Synchronous worker: work() runs inside schedule_work(), and its responses
+   are delivered after run() returns, as a host would */
+typedef struct {
+    const LV2_Worker_Interface* iface;
+    LV2_Handle instance;
+    uint8_t responses[MAX_RESPONSES][MAX_RESPONSE_SIZE];
+    uint32_t response_sizes[MAX_RESPONSES];
+    uint32_t response_count;
+    uint64_t work_ns;      // Time spent in work(), excluded from run() timing
+    uint32_t jobs;         // Number of work() calls
+} Worker;
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static LV2_URID urid_map(LV2_URID_Map_Handle handle, const char* uri)
+{
+    UridTable* table = (UridTable*)handle;
+    for (uint32_t i = 0; i < table->count; i++) {
+        if (!strcmp(table->uris[i], uri)) {
+            return i + 1;
+        }
+    }
+    char** uris = realloc(table->uris, (table->count + 1) * sizeof(char*));
+    if (!uris) {
+        return 0;
+    }
+    table->uris = uris;
+    table->uris[table->count] = strdup(uri);
+    return ++table->count;
+}
+
+static LV2_Worker_Status worker_respond(LV2_Worker_Respond_Handle handle, uint32_t size, const void* data)
+{
+    Worker* worker = (Worker*)handle;
+    if (worker->response_count >= MAX_RESPONSES || size > MAX_RESPONSE_SIZE) {
+        return LV2_WORKER_ERR_NO_SPACE;
+    }
+    memcpy(worker->responses[worker->response_count], data, size);
+    worker->response_sizes[worker->response_count++] = size;
+    return LV2_WORKER_SUCCESS;
+}
+
+static LV2_Worker_Status worker_schedule(LV2_Worker_Schedule_Handle handle, uint32_t size, const void* data)
+{
+    Worker* worker = (Worker*)handle;
+    uint64_t start = now_ns();
+    LV2_Worker_Status status = worker->iface->work(worker->instance, worker_respond, worker, size, data);
+    worker->work_ns += now_ns() - start;
+    worker->jobs++;
+    return status;
+}
+
+/* Deliver the responses queued during the last run() */
+static void worker_deliver(Worker* worker)
+{
+    for (uint32_t i = 0; i < worker->response_count; i++) {
+        worker->iface->work_response(worker->instance, worker->response_sizes[i], worker->responses[i]);
+    }
+    worker->response_count = 0;
+    if (worker->iface->end_run) {
+        worker->iface->end_run(worker->instance);
+    }
+}
+
+static int script_add(Script* script, double seconds, double rate, uint8_t status, uint8_t data1, uint8_t data2)
+{
+    if (script->count == script->capacity) {
+        size_t capacity = script->capacity ? script->capacity * 2 : 1024;
+        ScriptEvent* events = realloc(script->events, capacity * sizeof(ScriptEvent));
+        if (!events) {
+            return -1;
+        }
+        script->events = events;
+        script->capacity = capacity;
+    }
+    ScriptEvent* ev = &script->events[script->count++];
+    ev->frame = (uint64_t)(seconds * rate);
+    ev->msg[0] = status;
+    ev->msg[1] = data1;
+    ev->msg[2] = data2;
+    return 0;
+}
+
+/* Order events by frame; note-offs first so that a repeated note restarts */
+static int compare_events(const void* a, const void* b)
+{
+    const ScriptEvent* ea = (const ScriptEvent*)a;
+    const ScriptEvent* eb = (const ScriptEvent*)b;
+    if (ea->frame != eb->frame) {
+        return (ea->frame > eb->frame) - (ea->frame < eb->frame);
+    }
+    return (eb->msg[0] == 0x80) - (ea->msg[0] == 0x80);
+}
+
+/*
+ * Build the MIDI script: a 4-chord progression with a note every half
+ * second, a two-octave arpeggio at 20 notes per second over it, a triangle
+ * sweep on CC 74 and the mod wheel every 10 ms, and pitch bend wobbles
+ */
+static int build_script(Script* script, double seconds, double rate)
+{
+    static const int roots[4] = { 48, 45, 41, 43 };          // C, Am, F, G
+    static const int chord[4] = { 0, 4, 7, 12 };
+    static const int minor_chord[4] = { 0, 3, 7, 12 };
+    int failed = 0;
+
+    // Chords, held for most of each half-second beat
+    for (double t = 0.0; t < seconds; t += 0.5) {
+        int bar = (int)(t / 2.0) % 4;
+        const int* shape = (bar == 1) ? minor_chord : chord;
+        for (int i = 0; i < 4; i++) {
+            uint8_t note = (uint8_t)(roots[bar] + shape[i]);
+            failed |= script_add(script, t, rate, 0x90, note, 90);
+            failed |= script_add(script, t + 0.45, rate, 0x80, note, 0);
+        }
+    }
+
+    // Fast arpeggio across two octaves of the current chord, overlapping notes
+    int step = 0;
+    for (double t = 0.0; t < seconds; t += 0.05, step++) {
+        int bar = (int)(t / 2.0) % 4;
+        const int* shape = (bar == 1) ? minor_chord : chord;
+        int pos = step % 16;
+        int idx = (pos < 8) ? pos : 15 - pos;               // Up, then down
+        uint8_t note = (uint8_t)(roots[bar] + 24 + shape[idx % 4] + 12 * (idx / 4 % 2));
+        failed |= script_add(script, t, rate, 0x90, note, (uint8_t)(60 + (step * 7) % 60));
+        failed |= script_add(script, t + 0.08, rate, 0x80, note, 0);
+    }
+
+    // CC sweeps and pitch bend
+    for (double t = 0.0; t < seconds; t += 0.01) {
+        double phase = t / 2.0 - (int)(t / 2.0);
+        double tri = (phase < 0.5) ? phase * 2.0 : 2.0 - phase * 2.0;
+        failed |= script_add(script, t, rate, 0xB0, 74, (uint8_t)(tri * 127.0));
+        failed |= script_add(script, t, rate, 0xB0, 1, (uint8_t)(127 - tri * 127.0));
+        if ((int)(t * 100.0) % 2 == 0) {
+            int bend = 8192 + (int)((tri - 0.5) * 4000.0);
+            failed |= script_add(script, t, rate, 0xE0, (uint8_t)(bend & 0x7F), (uint8_t)(bend >> 7));
+        }
+    }
+
+    // Release everything at the end
+    failed |= script_add(script, seconds, rate, 0xB0, 123, 0);
+
+    qsort(script->events, script->count, sizeof(ScriptEvent), compare_events);
+    return failed;
+}
+
+/* Number of programs listed in the bundle's preset index, or 1 without one */
+static int read_program_count(const char* bundle_path)
+{
+    char path[4096];
+    snprintf(path, sizeof(path), "%s/%s", bundle_path, PRESET_INDEX_FILE);
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return 1;
+    }
+    uint8_t header[PRESET_INDEX_HEADER_SIZE];
+    int count = 1;
+    if (fread(header, 1, sizeof(header), file) == sizeof(header) &&
+        memcmp(header, PRESET_INDEX_MAGIC, 4) == 0) {
+        uint32_t presets = preset_index_get_u32(header + 8);
+        if (presets > 0) {
+            count = (int)presets;
+        }
+    }
+    fclose(file);
+    return count;
+}
+
+/* Read a memory figure (in kB) from /proc/self/status */
+static long read_status_kb(const char* key)
+{
+    FILE* file = fopen("/proc/self/status", "r");
+    if (!file) {
+        return -1;
+    }
+    char line[256];
+    long value = -1;
+    size_t key_len = strlen(key);
+    while (fgets(line, sizeof(line), file)) {
+        if (!strncmp(line, key, key_len) && line[key_len] == ':') {
+            value = strtol(line + key_len + 1, NULL, 10);
+            break;
+        }
+    }
+    fclose(file);
+    return value;
+}
+
+static void usage(const char* argv0)
+{
+    fprintf(stderr, "Usage: %s <plugin.so> <bundle dir> [-b block size] [-r sample rate] "
+                    "[-s seconds] [-p polyphony]\n", argv0);
+}
+
+int main(int argc, char** argv)
+{
+    uint32_t block_size = 128;
+    double rate = 48000.0;
+    double seconds = 10.0;
+    int32_t polyphony = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "b:r:s:p:")) != -1) {
+        switch (opt) {
+            case 'b': block_size = (uint32_t)atoi(optarg); break;
+            case 'r': rate = atof(optarg); break;
+            case 's': seconds = atof(optarg); break;
+            case 'p': polyphony = atoi(optarg); break;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+    if (argc - optind != 2 || block_size == 0 || rate <= 0.0 || seconds <= 0.0) {
+        usage(argv[0]);
+        return 1;
+    }
+    const char* library_path = argv[optind];
+    const char* bundle_path = argv[optind + 1];
+
+    // Load the plugin binary
+    void* library = dlopen(library_path, RTLD_NOW | RTLD_LOCAL);
+    if (!library) {
+        fprintf(stderr, "Failed to load %s: %s\n", library_path, dlerror());
+        return 1;
+    }
+    const LV2_Lib_Descriptor* lib_descriptor = NULL;
+    const LV2_Descriptor* descriptor = NULL;
+    LV2_Lib_Descriptor_Function get_lib_descriptor =
+        (LV2_Lib_Descriptor_Function)dlsym(library, "lv2_lib_descriptor");
+    if (get_lib_descriptor) {
+        const LV2_Feature* no_features[] = { NULL };
+        lib_descriptor = get_lib_descriptor(bundle_path, no_features);
+        descriptor = lib_descriptor ? lib_descriptor->get_plugin(lib_descriptor->handle, 0) : NULL;
+    } else {
+        LV2_Descriptor_Function get_descriptor = (LV2_Descriptor_Function)dlsym(library, "lv2_descriptor");
+        descriptor = get_descriptor ? get_descriptor(0) : NULL;
+    }
+    if (!descriptor) {
+        fprintf(stderr, "No plugin descriptor in %s\n", library_path);
+        dlclose(library);
+        return 1;
+    }
+
+    // Host features
+    UridTable urids = { NULL, 0 };
+    LV2_URID_Map map = { &urids, urid_map };
+    Worker worker;
+    memset(&worker, 0, sizeof(worker));
+    LV2_Worker_Schedule schedule = { &worker, worker_schedule };
+    worker.iface = descriptor->extension_data
+        ? (const LV2_Worker_Interface*)descriptor->extension_data(LV2_WORKER__interface) : NULL;
+
+    LV2_Options_Option options[2];
+    memset(options, 0, sizeof(options));
+    if (polyphony > 0) {
+        options[0].context = LV2_OPTIONS_INSTANCE;
+        options[0].key = urid_map(&urids, SF2LV2__polyphony);
+        options[0].size = sizeof(int32_t);
+        options[0].type = urid_map(&urids, LV2_ATOM__Int);
+        options[0].value = &polyphony;
+    }
+
+    LV2_Feature map_feature = { LV2_URID__map, &map };
+    LV2_Feature schedule_feature = { LV2_WORKER__schedule, &schedule };
+    LV2_Feature options_feature = { LV2_OPTIONS__options, options };
+    const LV2_Feature* features[] = { &map_feature, &options_feature, &schedule_feature, NULL };
+    if (!worker.iface) {
+        features[2] = NULL;  // Only offer a worker to plugins that can use it
+    }
+
+    // Instantiate
+    uint64_t start = now_ns();
+    LV2_Handle instance = descriptor->instantiate(descriptor, rate, bundle_path, features);
+    uint64_t instantiate_ns = now_ns() - start;
+    if (!instance) {
+        fprintf(stderr, "Failed to instantiate %s\n", descriptor->URI);
+        dlclose(library);
+        return 1;
+    }
+    worker.instance = instance;
+
+    // Connect ports
+    LV2_Atom_Sequence* events = aligned_alloc(8, EVENT_BUFFER_SIZE);
+    float* buffers = calloc((size_t)MAX_PORTS * block_size, sizeof(float));
+    if (!events || !buffers) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    descriptor->connect_port(instance, PORT_EVENTS, events);
+    for (uint32_t port = 1; port < MAX_PORTS; port++) {
+        descriptor->connect_port(instance, port, buffers + (size_t)port * block_size);
+    }
+    // Control port defaults: level 1, cutoff open, everything else 0
+    buffers[(size_t)PORT_LEVEL * block_size] = 1.0f;
+    buffers[(size_t)PORT_CUTOFF * block_size] = 1.0f;
+    float* program_port = buffers + (size_t)PORT_PROGRAM * block_size;
+
+    // Build the script
+    Script script = { NULL, 0, 0 };
+    if (build_script(&script, seconds, rate) != 0) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+    int program_count = read_program_count(bundle_path);
+
+    LV2_URID sequence_type = urid_map(&urids, LV2_ATOM__Sequence);
+    LV2_URID midi_type = urid_map(&urids, LV2_MIDI__MidiEvent);
+
+    descriptor->activate(instance);
+
+    // Run
+    uint64_t total_frames = (uint64_t)(seconds * rate);
+    uint64_t run_ns = 0;
+    uint64_t worst_ns = 0;
+    uint64_t worst_frame = 0;
+    uint32_t blocks = 0;
+    size_t next_event = 0;
+    size_t dropped = 0;
+    for (uint64_t frame = 0; frame < total_frames; frame += block_size, blocks++) {
+        uint32_t frames = (total_frames - frame < block_size) ? (uint32_t)(total_frames - frame) : block_size;
+
+        // Fill this block's events
+        events->atom.type = sequence_type;
+        events->body.unit = 0;
+        events->body.pad = 0;
+        lv2_atom_sequence_clear(events);
+        while (next_event < script.count && script.events[next_event].frame < frame + frames) {
+            struct {
+                LV2_Atom_Event event;
+                uint8_t msg[3];
+            } midi;
+            midi.event.time.frames = (int64_t)(script.events[next_event].frame - frame);
+            midi.event.body.type = midi_type;
+            midi.event.body.size = 3;
+            memcpy(midi.msg, script.events[next_event].msg, 3);
+            if (!lv2_atom_sequence_append_event(events, EVENT_BUFFER_SIZE - sizeof(LV2_Atom), &midi.event)) {
+                dropped++;
+            }
+            next_event++;
+        }
+
+        *program_port = (float)((int)(frame / rate / PROGRAM_INTERVAL) % program_count);
+
+        uint64_t work_before = worker.work_ns;
+        start = now_ns();
+        descriptor->run(instance, frames);
+        uint64_t elapsed = now_ns() - start - (worker.work_ns - work_before);
+        if (worker.iface) {
+            worker_deliver(&worker);
+        }
+
+        run_ns += elapsed;
+        if (elapsed > worst_ns) {
+            worst_ns = elapsed;
+            worst_frame = frame;
+        }
+    }
+
+    descriptor->deactivate(instance);
+
+    long rss_kb = read_status_kb("VmRSS");
+    long peak_kb = read_status_kb("VmHWM");
+    double period_ms = block_size * 1000.0 / rate;
+
+    printf("%s\n", descriptor->URI);
+    printf("  Block size %u at %.0f Hz, %.1f s (%u blocks, %zu events, %d programs)\n",
+           block_size, rate, seconds, blocks, script.count, program_count);
+    printf("  Instantiate: %10.3f ms\n", instantiate_ns / 1e6);
+    printf("  Render:      %10.1f ns/sample (%.2f%% of realtime)\n",
+           (double)run_ns / total_frames, 100.0 * run_ns / (seconds * 1e9));
+    printf("  Worst block: %10.3f ms (%.1f%% of the %.3f ms period, at %.2f s)\n",
+           worst_ns / 1e6, 100.0 * worst_ns / (period_ms * 1e6), period_ms, worst_frame / rate);
+    printf("  Worker:      %10.3f ms in %u jobs\n", worker.work_ns / 1e6, worker.jobs);
+    printf("  RSS:         %10.1f MB (peak %.1f MB)\n", rss_kb / 1024.0, peak_kb / 1024.0);
+    if (dropped > 0) {
+        printf("  Warning: %zu events did not fit in the event buffer\n", dropped);
+    }
+
+    descriptor->cleanup(instance);
+    if (lib_descriptor) {
+        lib_descriptor->cleanup(lib_descriptor->handle);
+    }
+    dlclose(library);
+
+    free(script.events);
+    free(buffers);
+    free(events);
+    for (uint32_t i = 0; i < urids.count; i++) {
+        free(urids.uris[i]);
+    }
+    free(urids.uris);
+    return 0;
+}
@@ -0,0 +1,22 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Bundle descriptor format (bundle_desc.h)
+ *
+ * The plugin binary is the same for every SoundFont. What identifies a
+ * plugin is written by the metadata generator into a small text file in
+ * the bundle, which the runtime reads when the host opens the bundle
+ * (lv2_lib_descriptor). One "key=value" pair per line:
+ *   uri=<plugin URI, matching the TTL files>
+ *   name=<plugin name>
+ * Unknown keys are ignored, so later versions can add entries.
+ */
+
+#ifndef BUNDLE_DESC_H
+#define BUNDLE_DESC_H
+
+#define BUNDLE_DESC_FILE "plugin.desc"
+
+#define BUNDLE_DESC_URI  "uri"
+#define BUNDLE_DESC_NAME "name"
+
+#endif
@@ -0,0 +1,30 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Plugin URIs (plugin_uris.h)
+ *
+ * URIs of the instantiation options understood by the plugin runtime.
+ * Hosts pass them through the LV2 options feature; the metadata generator
+ * lists them as supported options in the plugin TTL. The same keys, and the
+ * state properties below, are used by the plugin's state:interface.
+ */
+
+#ifndef PLUGIN_URIS_H
+#define PLUGIN_URIS_H
+
+#define SF2LV2_URI    "https://github.com/islainstruments/sf2lv2"
+#define SF2LV2_PREFIX SF2LV2_URI "#"
+
+#define SF2LV2__polyphony SF2LV2_PREFIX "polyphony"  // atom:Int, maximum voices
+#define SF2LV2__cpuCores  SF2LV2_PREFIX "cpuCores"   // atom:Int, FluidSynth render threads
+#define SF2LV2__dspBudget SF2LV2_PREFIX "dspBudget"  // atom:Float, voice governor target
+                                                     // in percent of the period (0 = off)
+
+// State properties (polyphony and dspBudget are saved under their option keys)
+#define SF2LV2__program  SF2LV2_PREFIX "program"   // atom:Int, program index of the program port
+#define SF2LV2__controls SF2LV2_PREFIX "controls"  // atom:Vector of atom:Float, the six control
+                                                   // port values in effect (cutoff to release)
+#define SF2LV2__channels SF2LV2_PREFIX "channels"  // atom:Vector of atom:Int, per MIDI channel:
+                                                   // bank, program, pitch bend, wheel sensitivity
+                                                   // and the 128 controller values
+
+#endif
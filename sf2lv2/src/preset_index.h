@@ -0,0 +1,61 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Preset index format (preset_index.h)
+ *
+ * The metadata generator writes a compact binary index of the SoundFont's
+ * presets into the plugin bundle, so the plugin runtime can build its
+ * program table without scanning the SoundFont. The index lists presets in
+ * program port order (sorted by bank, then program, banks 0-128), and for
+ * each preset the byte ranges of soundfont.sf2 that hold its sample data.
+ *
+ * Layout (all values little-endian):
+ *   Header  (16 bytes): magic "SF2I", u32 version, u32 preset_count, u32 range_count
+ *   Presets (32 bytes each): u16 bank, u16 program, u32 first_range,
+ *                            u32 range_count, char name[20] (not NUL-terminated)
+ *   Ranges  (16 bytes each): u64 file offset, u64 length
+ */
+
+#ifndef PRESET_INDEX_H
+#define PRESET_INDEX_H
+
+#include <stdint.h>
+
+#define PRESET_INDEX_FILE    "presets.idx"
+#define PRESET_INDEX_MAGIC   "SF2I"
+#define PRESET_INDEX_VERSION 1
+
+#define PRESET_INDEX_HEADER_SIZE 16
+#define PRESET_INDEX_PRESET_SIZE 32
+#define PRESET_INDEX_RANGE_SIZE  16
+#define PRESET_INDEX_NAME_SIZE   20
+
+/* Little-endian encoders */
+static inline void preset_index_put_u16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void preset_index_put_u32(uint8_t* p, uint32_t v) {
+    preset_index_put_u16(p, (uint16_t)v);
+    preset_index_put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline void preset_index_put_u64(uint8_t* p, uint64_t v) {
+    preset_index_put_u32(p, (uint32_t)v);
+    preset_index_put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+/* Little-endian decoders */
+static inline uint16_t preset_index_get_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t preset_index_get_u32(const uint8_t* p) {
+    return (uint32_t)preset_index_get_u16(p) | ((uint32_t)preset_index_get_u16(p + 2) << 16);
+}
+
+static inline uint64_t preset_index_get_u64(const uint8_t* p) {
+    return (uint64_t)preset_index_get_u32(p) | ((uint64_t)preset_index_get_u32(p + 4) << 32);
+}
+
+#endif
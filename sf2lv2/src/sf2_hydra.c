@@ -0,0 +1,382 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * SoundFont structure reader (sf2_hydra.c)
+ *
+ * Streams over the RIFF chunks of a SoundFont (INFO, sdta, pdta), records
+ * where the sample data lives and decodes the preset data tables.
+ * All multi-byte values in a SoundFont are little-endian.
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include "sf2_hydra.h"
+
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* On-disk record sizes of the pdta tables */
+#define PHDR_SIZE 38
+#define BAG_SIZE  4
+#define MOD_SIZE  10
+#define GEN_SIZE  4
+#define INST_SIZE 22
+#define SHDR_SIZE 46
+
+/* Little-endian field readers */
+static uint16_t get_u16(const uint8_t* p) {
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+/* Copy a fixed-width 20-character name and NUL-terminate it */
+static void get_name(char* dst, const uint8_t* src) {
+    memcpy(dst, src, 20);
+    dst[20] = '\0';
+}
+
+/* Format an error message and return -1 */
+static int fail(char* err, size_t err_size, const char* fmt, ...) {
+    if (err && err_size > 0) {
+        va_list args;
+        va_start(args, fmt);
+        vsnprintf(err, err_size, fmt, args);
+        va_end(args);
+    }
+    return -1;
+}
+
+/* Read a chunk header (four-character ID and body size) at the current position */
+static int read_chunk_header(FILE* file, char id[5], uint32_t* size) {
+    uint8_t header[8];
+    if (fread(header, 1, sizeof(header), file) != sizeof(header)) {
+        return -1;
+    }
+    memcpy(id, header, 4);
+    id[4] = '\0';
+    *size = get_u32(header + 4);
+    return 0;
+}
+
+/* Read a whole pdta table into memory, checking it holds whole records */
+static uint8_t* read_table(FILE* file, uint32_t size, uint32_t record_size,
+                           const char* id, uint32_t* count, char* err, size_t err_size) {
+    if (size % record_size != 0) {
+        fail(err, err_size, "%s chunk size %u is not a multiple of %u", id, size, record_size);
+        return NULL;
+    }
+    uint8_t* data = (uint8_t*)malloc(size ? size : 1);
+    if (!data) {
+        fail(err, err_size, "Out of memory reading %s chunk", id);
+        return NULL;
+    }
+    if (size && fread(data, 1, size, file) != size) {
+        fail(err, err_size, "Truncated %s chunk", id);
+        free(data);
+        return NULL;
+    }
+    *count = size / record_size;
+    return data;
+}
+
+/* Decode a raw pdta table into its record array */
+static int decode_table(SF2Hydra* hydra, const char* id, const uint8_t* raw, uint32_t count) {
+    // A repeated table replaces the earlier one
+    if (!strcmp(id, "phdr")) {
+        free(hydra->phdr);
+        hydra->phdr = (SF2PresetHeader*)calloc(count ? count : 1, sizeof(SF2PresetHeader));
+        if (!hydra->phdr) return -1;
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t* r = raw + i * PHDR_SIZE;
+            get_name(hydra->phdr[i].name, r);
+            hydra->phdr[i].preset = get_u16(r + 20);
+            hydra->phdr[i].bank = get_u16(r + 22);
+            hydra->phdr[i].bag_index = get_u16(r + 24);
+            hydra->phdr[i].library = get_u32(r + 26);
+            hydra->phdr[i].genre = get_u32(r + 30);
+            hydra->phdr[i].morphology = get_u32(r + 34);
+        }
+        hydra->phdr_count = count;
+    } else if (!strcmp(id, "pbag") || !strcmp(id, "ibag")) {
+        SF2Bag* bags = (SF2Bag*)calloc(count ? count : 1, sizeof(SF2Bag));
+        if (!bags) return -1;
+        for (uint32_t i = 0; i < count; i++) {
+            bags[i].gen_index = get_u16(raw + i * BAG_SIZE);
+            bags[i].mod_index = get_u16(raw + i * BAG_SIZE + 2);
+        }
+        if (id[0] == 'p') {
+            free(hydra->pbag);
+            hydra->pbag = bags;
+            hydra->pbag_count = count;
+        } else {
+            free(hydra->ibag);
+            hydra->ibag = bags;
+            hydra->ibag_count = count;
+        }
+    } else if (!strcmp(id, "pmod") || !strcmp(id, "imod")) {
+        SF2Mod* mods = (SF2Mod*)calloc(count ? count : 1, sizeof(SF2Mod));
+        if (!mods) return -1;
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t* r = raw + i * MOD_SIZE;
+            mods[i].src_oper = get_u16(r);
+            mods[i].dest_oper = get_u16(r + 2);
+            mods[i].amount = (int16_t)get_u16(r + 4);
+            mods[i].amt_src_oper = get_u16(r + 6);
+            mods[i].trans_oper = get_u16(r + 8);
+        }
+        if (id[0] == 'p') {
+            free(hydra->pmod);
+            hydra->pmod = mods;
+            hydra->pmod_count = count;
+        } else {
+            free(hydra->imod);
+            hydra->imod = mods;
+            hydra->imod_count = count;
+        }
+    } else if (!strcmp(id, "pgen") || !strcmp(id, "igen")) {
+        SF2Gen* gens = (SF2Gen*)calloc(count ? count : 1, sizeof(SF2Gen));
+        if (!gens) return -1;
+        for (uint32_t i = 0; i < count; i++) {
+            gens[i].oper = get_u16(raw + i * GEN_SIZE);
+            gens[i].amount = get_u16(raw + i * GEN_SIZE + 2);
+        }
+        if (id[0] == 'p') {
+            free(hydra->pgen);
+            hydra->pgen = gens;
+            hydra->pgen_count = count;
+        } else {
+            free(hydra->igen);
+            hydra->igen = gens;
+            hydra->igen_count = count;
+        }
+    } else if (!strcmp(id, "inst")) {
+        free(hydra->inst);
+        hydra->inst = (SF2Inst*)calloc(count ? count : 1, sizeof(SF2Inst));
+        if (!hydra->inst) return -1;
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t* r = raw + i * INST_SIZE;
+            get_name(hydra->inst[i].name, r);
+            hydra->inst[i].bag_index = get_u16(r + 20);
+        }
+        hydra->inst_count = count;
+    } else if (!strcmp(id, "shdr")) {
+        free(hydra->shdr);
+        hydra->shdr = (SF2SampleHeader*)calloc(count ? count : 1, sizeof(SF2SampleHeader));
+        if (!hydra->shdr) return -1;
+        for (uint32_t i = 0; i < count; i++) {
+            const uint8_t* r = raw + i * SHDR_SIZE;
+            SF2SampleHeader* h = &hydra->shdr[i];
+            get_name(h->name, r);
+            h->start = get_u32(r + 20);
+            h->end = get_u32(r + 24);
+            h->loop_start = get_u32(r + 28);
+            h->loop_end = get_u32(r + 32);
+            h->sample_rate = get_u32(r + 36);
+            h->original_pitch = r[40];
+            h->pitch_correction = (int8_t)r[41];
+            h->sample_link = get_u16(r + 42);
+            h->sample_type = get_u16(r + 44);
+        }
+        hydra->shdr_count = count;
+    }
+    return 0;
+}
+
+/* Return the record size of a pdta table, or 0 for unknown chunk IDs */
+static uint32_t table_record_size(const char* id) {
+    if (!strcmp(id, "phdr")) return PHDR_SIZE;
+    if (!strcmp(id, "pbag") || !strcmp(id, "ibag")) return BAG_SIZE;
+    if (!strcmp(id, "pmod") || !strcmp(id, "imod")) return MOD_SIZE;
+    if (!strcmp(id, "pgen") || !strcmp(id, "igen")) return GEN_SIZE;
+    if (!strcmp(id, "inst")) return INST_SIZE;
+    if (!strcmp(id, "shdr")) return SHDR_SIZE;
+    return 0;
+}
+
+/* Walk the sub-chunks of a LIST chunk whose body spans [start, end) */
+static int read_list(FILE* file, SF2Hydra* hydra, const char* type,
+                     uint64_t start, uint64_t end, char* err, size_t err_size) {
+    uint64_t pos = start;
+
+    while (pos + 8 <= end) {
+        char id[5];
+        uint32_t size;
+        if (fseeko(file, (off_t)pos, SEEK_SET) != 0 || read_chunk_header(file, id, &size) != 0) {
+            return fail(err, err_size, "Truncated %s list", type);
+        }
+        uint64_t body = pos + 8;
+        if (body + size > end) {
+            return fail(err, err_size, "%s chunk in %s list overruns its parent (%u bytes)", id, type, size);
+        }
+
+        if (!strcmp(type, "INFO") && !strcmp(id, "ifil")) {
+            uint8_t ver[4];
+            if (size < 4 || fread(ver, 1, 4, file) != 4) {
+                return fail(err, err_size, "Invalid ifil chunk");
+            }
+            hydra->version_major = get_u16(ver);
+            hydra->version_minor = get_u16(ver + 2);
+        } else if (!strcmp(type, "sdta") && !strcmp(id, "smpl")) {
+            hydra->smpl_offset = body;
+            hydra->smpl_size = size;
+        } else if (!strcmp(type, "sdta") && !strcmp(id, "sm24")) {
+            hydra->sm24_offset = body;
+            hydra->sm24_size = size;
+        } else if (!strcmp(type, "pdta")) {
+            uint32_t record_size = table_record_size(id);
+            if (record_size) {
+                uint32_t count;
+                uint8_t* raw = read_table(file, size, record_size, id, &count, err, err_size);
+                if (!raw) {
+                    return -1;
+                }
+                int result = decode_table(hydra, id, raw, count);
+                free(raw);
+                if (result != 0) {
+                    return fail(err, err_size, "Out of memory decoding %s chunk", id);
+                }
+            }
+        }
+
+        // Chunks are padded to an even size
+        pos = body + size + (size & 1);
+    }
+    return 0;
+}
+
+int sf2_hydra_read(FILE* file, SF2Hydra* hydra, char* err, size_t err_size) {
+    memset(hydra, 0, sizeof(*hydra));
+
+    if (fseeko(file, 0, SEEK_END) != 0) {
+        return fail(err, err_size, "File is not seekable");
+    }
+    hydra->file_size = (uint64_t)ftello(file);
+
+    // RIFF header: "RIFF" <size> "sfbk"
+    char id[5];
+    uint32_t riff_size;
+    uint8_t form[4];
+    if (fseeko(file, 0, SEEK_SET) != 0 || read_chunk_header(file, id, &riff_size) != 0 ||
+        fread(form, 1, 4, file) != 4) {
+        return fail(err, err_size, "File too short for a RIFF header");
+    }
+    if (strcmp(id, "RIFF") != 0 || memcmp(form, "sfbk", 4) != 0) {
+        return fail(err, err_size, "Not a SoundFont (missing RIFF sfbk header)");
+    }
+    uint64_t riff_end = 8 + (uint64_t)riff_size;
+    if (riff_end > hydra->file_size) {
+        return fail(err, err_size, "File truncated: RIFF declares %llu bytes, file has %llu",
+                    (unsigned long long)riff_end, (unsigned long long)hydra->file_size);
+    }
+
+    // Top-level chunks: LIST INFO, LIST sdta, LIST pdta
+    bool have_info = false, have_sdta = false, have_pdta = false;
+    uint64_t pos = 12;
+    while (pos + 8 <= riff_end) {
+        uint32_t size;
+        if (fseeko(file, (off_t)pos, SEEK_SET) != 0 || read_chunk_header(file, id, &size) != 0) {
+            sf2_hydra_free(hydra);
+            return fail(err, err_size, "Truncated chunk header at offset %llu", (unsigned long long)pos);
+        }
+        uint64_t body = pos + 8;
+        if (body + size > riff_end) {
+            sf2_hydra_free(hydra);
+            return fail(err, err_size, "%s chunk at offset %llu overruns the file (%u bytes)",
+                        id, (unsigned long long)pos, size);
+        }
+
+        if (!strcmp(id, "LIST") && size >= 4) {
+            uint8_t type_raw[4];
+            if (fread(type_raw, 1, 4, file) != 4) {
+                sf2_hydra_free(hydra);
+                return fail(err, err_size, "Truncated LIST chunk");
+            }
+            char type[5];
+            memcpy(type, type_raw, 4);
+            type[4] = '\0';
+
+            if (read_list(file, hydra, type, body + 4, body + size, err, err_size) != 0) {
+                sf2_hydra_free(hydra);
+                return -1;
+            }
+            have_info |= !strcmp(type, "INFO");
+            have_sdta |= !strcmp(type, "sdta");
+            have_pdta |= !strcmp(type, "pdta");
+            if (!strcmp(type, "INFO")) {
+                hydra->info_offset = body + 4;
+                hydra->info_size = size - 4;
+            }
+        }
+
+        pos = body + size + (size & 1);
+    }
+
+    // The INFO list and the pdta tables are mandatory, each table with at
+    // least its terminal record (and a real preset, instrument and sample)
+    const char* missing = NULL;
+    if (!have_info || hydra->version_major == 0) missing = "INFO list or ifil chunk";
+    else if (!have_sdta || !hydra->smpl_offset) missing = "sdta list or smpl chunk";
+    else if (!have_pdta) missing = "pdta list";
+    else if (hydra->phdr_count < 2) missing = "phdr records";
+    else if (hydra->pbag_count < 1) missing = "pbag records";
+    else if (hydra->pgen_count < 1) missing = "pgen records";
+    else if (hydra->inst_count < 2) missing = "inst records";
+    else if (hydra->ibag_count < 1) missing = "ibag records";
+    else if (hydra->igen_count < 1) missing = "igen records";
+    else if (hydra->shdr_count < 2) missing = "shdr records";
+    if (missing) {
+        sf2_hydra_free(hydra);
+        return fail(err, err_size, "Missing %s", missing);
+    }
+
+    return 0;
+}
+
+void sf2_hydra_free(SF2Hydra* hydra) {
+    free(hydra->phdr);
+    free(hydra->pbag);
+    free(hydra->pmod);
+    free(hydra->pgen);
+    free(hydra->inst);
+    free(hydra->ibag);
+    free(hydra->imod);
+    free(hydra->igen);
+    free(hydra->shdr);
+    memset(hydra, 0, sizeof(*hydra));
+}
+
+/* Mark the samples used by one instrument */
+static void instrument_samples(const SF2Hydra* hydra, uint32_t inst, uint8_t* used) {
+    if (inst + 1 >= hydra->inst_count) {
+        return;
+    }
+    uint32_t bag_end = hydra->inst[inst + 1].bag_index;
+    for (uint32_t bag = hydra->inst[inst].bag_index; bag < bag_end && bag + 1 < hydra->ibag_count; bag++) {
+        uint32_t gen_end = hydra->ibag[bag + 1].gen_index;
+        for (uint32_t gen = hydra->ibag[bag].gen_index; gen < gen_end && gen < hydra->igen_count; gen++) {
+            if (hydra->igen[gen].oper == SF2_GEN_SAMPLE_ID &&
+                hydra->igen[gen].amount + 1u < hydra->shdr_count) {
+                used[hydra->igen[gen].amount] = 1;
+            }
+        }
+    }
+}
+
+void sf2_hydra_preset_samples(const SF2Hydra* hydra, uint32_t preset, uint8_t* used) {
+    if (preset + 1 >= hydra->phdr_count) {
+        return;
+    }
+    uint32_t bag_end = hydra->phdr[preset + 1].bag_index;
+    for (uint32_t bag = hydra->phdr[preset].bag_index; bag < bag_end && bag + 1 < hydra->pbag_count; bag++) {
+        uint32_t gen_end = hydra->pbag[bag + 1].gen_index;
+        for (uint32_t gen = hydra->pbag[bag].gen_index; gen < gen_end && gen < hydra->pgen_count; gen++) {
+            if (hydra->pgen[gen].oper == SF2_GEN_INSTRUMENT) {
+                instrument_samples(hydra, hydra->pgen[gen].amount, used);
+            }
+        }
+    }
+}
@@ -0,0 +1,125 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * SoundFont structure reader (sf2_hydra.h)
+ *
+ * Reads the RIFF layout of a SoundFont 2 file and its "hydra" - the nine
+ * preset data (pdta) tables that describe presets, instruments and samples -
+ * without loading any sample data. Used by the build tools; the plugin
+ * runtime itself loads SoundFonts through FluidSynth.
+ *
+ * Record layouts follow the SoundFont 2.04 specification, section 7.
+ * Every table keeps its terminal record (EOP/EOI/EOS), so a table with
+ * N real entries has a count of N + 1.
+ */
+
+#ifndef SF2_HYDRA_H
+#define SF2_HYDRA_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* Generator operators used to follow zones down to their samples */
+#define SF2_GEN_INSTRUMENT 41   // Preset zone -> instrument index
+#define SF2_GEN_SAMPLE_ID  53   // Instrument zone -> sample index
+
+/* Zero-valued data points the specification requires after every sample */
+#define SF2_SAMPLE_GUARD_POINTS 46
+
+/* Preset header (phdr), 38 bytes on disk */
+typedef struct {
+    char name[21];          // Preset name (NUL-terminated copy)
+    uint16_t preset;        // MIDI program number
+    uint16_t bank;          // MIDI bank number
+    uint16_t bag_index;     // First zone in pbag
+    uint32_t library;       // Reserved
+    uint32_t genre;         // Reserved
+    uint32_t morphology;    // Reserved
+} SF2PresetHeader;
+
+/* Zone (pbag/ibag), 4 bytes on disk */
+typedef struct {
+    uint16_t gen_index;     // First generator of the zone
+    uint16_t mod_index;     // First modulator of the zone
+} SF2Bag;
+
+/* Modulator (pmod/imod), 10 bytes on disk */
+typedef struct {
+    uint16_t src_oper;      // Modulation source
+    uint16_t dest_oper;     // Destination generator
+    int16_t amount;         // Modulation depth
+    uint16_t amt_src_oper;  // Secondary source
+    uint16_t trans_oper;    // Transform
+} SF2Mod;
+
+/* Generator (pgen/igen), 4 bytes on disk */
+typedef struct {
+    uint16_t oper;          // Generator operator
+    uint16_t amount;        // Raw amount (signed, unsigned or a byte range)
+} SF2Gen;
+
+/* Instrument header (inst), 22 bytes on disk */
+typedef struct {
+    char name[21];          // Instrument name (NUL-terminated copy)
+    uint16_t bag_index;     // First zone in ibag
+} SF2Inst;
+
+/* Sample header (shdr), 46 bytes on disk */
+typedef struct {
+    char name[21];          // Sample name (NUL-terminated copy)
+    uint32_t start;         // First data point (in sample points)
+    uint32_t end;           // One past the last data point
+    uint32_t loop_start;    // Loop start point
+    uint32_t loop_end;      // Loop end point
+    uint32_t sample_rate;   // Sample rate in Hz
+    uint8_t original_pitch; // MIDI key of the recording
+    int8_t pitch_correction;// Pitch correction in cents
+    uint16_t sample_link;   // Linked sample for stereo pairs
+    uint16_t sample_type;   // Mono/left/right/linked, ROM and compression flags
+} SF2SampleHeader;
+
+/* RIFF layout and preset data of a SoundFont file */
+typedef struct {
+    uint64_t file_size;     // Size of the whole file in bytes
+
+    uint16_t version_major; // ifil major version (2 for SF2, 3 for SF3)
+    uint16_t version_minor; // ifil minor version
+
+    uint64_t info_offset;   // File offset of the INFO list body (after "INFO")
+    uint32_t info_size;     // Size of the INFO list body
+    uint64_t smpl_offset;   // File offset of the 16-bit sample data
+    uint32_t smpl_size;     // Size of the 16-bit sample data in bytes
+    uint64_t sm24_offset;   // File offset of the 24-bit extension (0 if none)
+    uint32_t sm24_size;     // Size of the 24-bit extension in bytes
+
+    SF2PresetHeader* phdr;  uint32_t phdr_count;
+    SF2Bag* pbag;           uint32_t pbag_count;
+    SF2Mod* pmod;           uint32_t pmod_count;
+    SF2Gen* pgen;           uint32_t pgen_count;
+    SF2Inst* inst;          uint32_t inst_count;
+    SF2Bag* ibag;           uint32_t ibag_count;
+    SF2Mod* imod;           uint32_t imod_count;
+    SF2Gen* igen;           uint32_t igen_count;
+    SF2SampleHeader* shdr;  uint32_t shdr_count;
+} SF2Hydra;
+
+/*
+ * Read the RIFF layout and hydra of a SoundFont.
+ * Chunk sizes are checked against their parents and the file size, and table
+ * sizes against their record sizes. Sample data is skipped, not read.
+ * Returns: 0 on success, -1 on failure with a message in err
+ */
+int sf2_hydra_read(FILE* file, SF2Hydra* hydra, char* err, size_t err_size);
+
+/*
+ * Free the tables allocated by sf2_hydra_read()
+ */
+void sf2_hydra_free(SF2Hydra* hydra);
+
+/*
+ * Mark the samples used by a preset, following its zones through their
+ * instruments. used must hold shdr_count entries; marked entries are set to 1.
+ * Out-of-range indices in malformed files are skipped
+ */
+void sf2_hydra_preset_samples(const SF2Hydra* hydra, uint32_t preset, uint8_t* used);
+
+#endif
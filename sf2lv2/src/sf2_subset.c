@@ -0,0 +1,646 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * SoundFont subsetter (sf2_subset.c)
+ *
+ * Writes a minimal copy of a SoundFont for the plugin bundle:
+ * 1. Keeps the selected presets (all presets when none are given)
+ * 2. Keeps only the instruments those presets use, and only the samples
+ *    (with their stereo partners) those instruments use
+ * 3. Drops the 24-bit sm24 extension, which the plugin targets never use
+ * 4. With -c (builds with SF3=1), compresses the kept samples to Ogg Vorbis
+ *    at the given quality (0.0 - 1.0), writing an SF3 file
+ * The INFO list is copied unchanged (apart from the version for SF3); the
+ * preset data tables are rewritten with renumbered indices and the kept
+ * samples are packed together, each followed by the zero guard points the
+ * specification requires. Compressed samples are separate Vorbis streams
+ * addressed in bytes and need no guard points.
+ *
+ * Usage: sf2_subset [-c quality] <in.sf2> <out.sf2> [bank:program ...]
+ */
+
+#define _FILE_OFFSET_BITS 64
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+
+#ifndef SF3
+#define SF3 0
+#endif
+
+#if SF3
+#include <sndfile.h>
+#endif
+
+#include "sf2_hydra.h"
+
+/* On-disk record sizes of the pdta tables */
+#define PHDR_SIZE 38
+#define BAG_SIZE  4
+#define MOD_SIZE  10
+#define GEN_SIZE  4
+#define INST_SIZE 22
+#define SHDR_SIZE 46
+
+/* Sample type flags (SoundFont 2.04, section 7.10) */
+#define SAMPLE_RIGHT      0x0002
+#define SAMPLE_LEFT       0x0004
+#define SAMPLE_LINKED     0x0008
+#define SAMPLE_COMPRESSED 0x0010
+#define SAMPLE_ROM        0x8000
+
+#define NONE UINT32_MAX
+
+/* A growable byte buffer holding one pdta table */
+typedef struct {
+    uint8_t* data;
+    size_t size;
+    size_t capacity;
+} Table;
+
+static uint8_t* table_append(Table* t, size_t n) {
+    if (t->size + n > t->capacity) {
+        size_t capacity = t->capacity ? t->capacity * 2 : 4096;
+        while (capacity < t->size + n) capacity *= 2;
+        uint8_t* grown = realloc(t->data, capacity);
+        if (!grown) {
+            fprintf(stderr, "Out of memory\n");
+            exit(1);
+        }
+        t->data = grown;
+        t->capacity = capacity;
+    }
+    uint8_t* p = t->data + t->size;
+    memset(p, 0, n);
+    t->size += n;
+    return p;
+}
+
+/* Little-endian field writers */
+static void put_u16(uint8_t* p, uint16_t v) {
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32(uint8_t* p, uint32_t v) {
+    put_u16(p, (uint16_t)v);
+    put_u16(p + 2, (uint16_t)(v >> 16));
+}
+
+/* Names are 20 bytes, NUL-padded (p is already zeroed) */
+static void put_name(uint8_t* p, const char* name) {
+    memcpy(p, name, strnlen(name, 20));
+}
+
+static void write_u32(FILE* out, uint32_t v) {
+    uint8_t b[4];
+    put_u32(b, v);
+    fwrite(b, 1, 4, out);
+}
+
+static void write_chunk_header(FILE* out, const char* id, uint32_t size) {
+    fwrite(id, 1, 4, out);
+    write_u32(out, size);
+}
+
+#if SF3
+/* Read the 16-bit points of a sample into pcm */
+static int read_points(FILE* in, const SF2Hydra* hydra, const SF2SampleHeader* h, int16_t* pcm) {
+    uint32_t frames = h->end - h->start;
+    uint8_t* bytes = (uint8_t*)pcm;
+    fseeko(in, (off_t)(hydra->smpl_offset + (uint64_t)h->start * 2), SEEK_SET);
+    if (fread(bytes, 2, frames, in) != frames) {
+        return -1;
+    }
+    // Stored little-endian; converting in place only reads bytes not yet written
+    for (uint32_t i = 0; i < frames; i++) {
+        pcm[i] = (int16_t)(bytes[2 * i] | (bytes[2 * i + 1] << 8));
+    }
+    return 0;
+}
+
+/* libsndfile virtual I/O writing into a Table, starting at its size when opened */
+typedef struct {
+    Table* table;
+    size_t base;
+    sf_count_t pos;
+} MemFile;
+
+static sf_count_t mem_length(void* user) {
+    MemFile* m = user;
+    return (sf_count_t)(m->table->size - m->base);
+}
+
+static sf_count_t mem_seek(sf_count_t offset, int whence, void* user) {
+    MemFile* m = user;
+    if (whence == SEEK_CUR) offset += m->pos;
+    else if (whence == SEEK_END) offset += mem_length(m);
+    if (offset < 0) return -1;
+    m->pos = offset;
+    return offset;
+}
+
+static sf_count_t mem_read(void* ptr, sf_count_t count, void* user) {
+    MemFile* m = user;
+    sf_count_t available = mem_length(m) - m->pos;
+    if (count > available) count = available > 0 ? available : 0;
+    memcpy(ptr, m->table->data + m->base + m->pos, (size_t)count);
+    m->pos += count;
+    return count;
+}
+
+static sf_count_t mem_write(const void* ptr, sf_count_t count, void* user) {
+    MemFile* m = user;
+    sf_count_t end = m->pos + count;
+    if (end > mem_length(m)) {
+        table_append(m->table, (size_t)(end - mem_length(m)));
+    }
+    memcpy(m->table->data + m->base + m->pos, ptr, (size_t)count);
+    m->pos = end;
+    return count;
+}
+
+static sf_count_t mem_tell(void* user) {
+    return ((MemFile*)user)->pos;
+}
+
+/* Append a sample to out as a mono Ogg Vorbis stream */
+static int encode_vorbis(const int16_t* pcm, uint32_t frames, uint32_t rate, double quality, Table* out) {
+    MemFile mem = { out, out->size, 0 };
+    SF_VIRTUAL_IO io = { mem_length, mem_seek, mem_read, mem_write, mem_tell };
+    SF_INFO info = { .samplerate = (int)rate, .channels = 1, .format = SF_FORMAT_OGG | SF_FORMAT_VORBIS };
+
+    SNDFILE* snd = sf_open_virtual(&io, SFM_WRITE, &info, &mem);
+    if (!snd) {
+        fprintf(stderr, "Vorbis encoder: %s\n", sf_strerror(NULL));
+        return -1;
+    }
+    sf_command(snd, SFC_SET_VBR_ENCODING_QUALITY, &quality, sizeof(quality));
+    int failed = sf_write_short(snd, pcm, frames) != (sf_count_t)frames;
+    if (failed) {
+        fprintf(stderr, "Vorbis encoder: %s\n", sf_strerror(snd));
+    }
+    return sf_close(snd) != 0 || failed ? -1 : 0;
+}
+#endif
+
+/* Set the major version in the ifil chunk of an INFO list */
+static void set_info_version(uint8_t* info, size_t size, uint16_t major) {
+    size_t pos = 0;
+    while (pos + 8 <= size) {
+        uint32_t len = info[pos + 4] | (info[pos + 5] << 8) | (info[pos + 6] << 16) | ((uint32_t)info[pos + 7] << 24);
+        if (!memcmp(info + pos, "ifil", 4) && len >= 4 && pos + 8 + len <= size) {
+            put_u16(info + pos + 8, major);
+            return;
+        }
+        pos += 8 + (size_t)len + (len & 1);
+    }
+}
+
+/* Move a point of sample h so that its start lands on base */
+static int move_point(const SF2SampleHeader* h, uint32_t point, uint32_t base, uint32_t* moved) {
+    int64_t value = (int64_t)base + ((int64_t)point - h->start);
+    if (value < 0 || value > UINT32_MAX) {
+        return -1;
+    }
+    *moved = (uint32_t)value;
+    return 0;
+}
+
+/* Whether the data of sample h can be copied. Compressed samples and samples
+   outside the sample data are written empty instead; FluidSynth would not
+   play them either, and sf2_validate only warns about them */
+static int sample_copyable(const SF2Hydra* hydra, const SF2SampleHeader* h) {
+    return !(h->sample_type & SAMPLE_COMPRESSED) && h->end >= h->start &&
+           (uint64_t)h->end * 2 <= hydra->smpl_size;
+}
+
+/* Table indices are 16 bits on disk */
+static uint16_t index16(size_t index, const char* table) {
+    if (index > UINT16_MAX) {
+        fprintf(stderr, "Subset too large: more than 65535 %s records\n", table);
+        exit(1);
+    }
+    return (uint16_t)index;
+}
+
+/* Zone ranges, clamped to the tables so malformed files cannot overrun them */
+static uint32_t bag_end(const SF2Bag* bags, uint32_t bag_count, uint32_t bag, int gen) {
+    if (bag + 1 >= bag_count) return bag;
+    return gen ? bags[bag + 1].gen_index : bags[bag + 1].mod_index;
+}
+
+/* Copy the zones [first, last) of a preset or instrument, with their
+   generators and modulators, renumbering the link generator (instrument or
+   sample ID) through remap. Generators whose target was dropped are removed. */
+static void copy_zones(const SF2Bag* bags, uint32_t bag_count,
+                       const SF2Gen* gens, uint32_t gen_count,
+                       const SF2Mod* mods, uint32_t mod_count,
+                       uint32_t first, uint32_t last, uint16_t link_oper, const uint32_t* remap,
+                       uint32_t remap_count, Table* out_bags, Table* out_gens, Table* out_mods,
+                       const char* prefix) {
+    for (uint32_t bag = first; bag < last && bag + 1 < bag_count; bag++) {
+        uint8_t* b = table_append(out_bags, BAG_SIZE);
+        put_u16(b, index16(out_gens->size / GEN_SIZE, prefix));
+        put_u16(b + 2, index16(out_mods->size / MOD_SIZE, prefix));
+
+        uint32_t gen_last = bag_end(bags, bag_count, bag, 1);
+        for (uint32_t g = bags[bag].gen_index; g < gen_last && g < gen_count; g++) {
+            uint16_t amount = gens[g].amount;
+            if (gens[g].oper == link_oper) {
+                if (amount >= remap_count || remap[amount] == NONE) {
+                    continue;
+                }
+                amount = (uint16_t)remap[amount];
+            }
+            uint8_t* r = table_append(out_gens, GEN_SIZE);
+            put_u16(r, gens[g].oper);
+            put_u16(r + 2, amount);
+        }
+
+        uint32_t mod_last = bag_end(bags, bag_count, bag, 0);
+        for (uint32_t m = bags[bag].mod_index; m < mod_last && m < mod_count; m++) {
+            uint8_t* r = table_append(out_mods, MOD_SIZE);
+            put_u16(r, mods[m].src_oper);
+            put_u16(r + 2, mods[m].dest_oper);
+            put_u16(r + 4, (uint16_t)mods[m].amount);
+            put_u16(r + 6, mods[m].amt_src_oper);
+            put_u16(r + 8, mods[m].trans_oper);
+        }
+    }
+}
+
+/* Mark the link targets (instruments or samples) used by the zones [first, last) */
+static void mark_links(const SF2Bag* bags, uint32_t bag_count, const SF2Gen* gens, uint32_t gen_count,
+                       uint32_t first, uint32_t last, uint16_t link_oper,
+                       uint8_t* used, uint32_t used_count) {
+    for (uint32_t bag = first; bag < last && bag + 1 < bag_count; bag++) {
+        uint32_t gen_last = bag_end(bags, bag_count, bag, 1);
+        for (uint32_t g = bags[bag].gen_index; g < gen_last && g < gen_count; g++) {
+            if (gens[g].oper == link_oper && gens[g].amount < used_count) {
+                used[gens[g].amount] = 1;
+            }
+        }
+    }
+}
+
+/* Parse the "bank:program" selections; returns 1 if the preset is selected */
+static int preset_selected(const SF2PresetHeader* p, int argc, char** argv) {
+    if (argc == 0) {
+        return 1;
+    }
+    for (int i = 0; i < argc; i++) {
+        unsigned bank, program;
+        if (sscanf(argv[i], "%u:%u", &bank, &program) == 2 &&
+            bank == p->bank && program == p->preset) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Append the terminal record of each table */
+static void terminate_tables(Table* hdr, size_t hdr_size, const char* hdr_name, size_t name_offset,
+                             size_t bag_offset, Table* bags, Table* gens, Table* mods) {
+    uint8_t* r = table_append(hdr, hdr_size);
+    put_name(r + name_offset, hdr_name);
+    put_u16(r + bag_offset, index16(bags->size / BAG_SIZE, hdr_name));
+
+    uint8_t* b = table_append(bags, BAG_SIZE);
+    put_u16(b, index16(gens->size / GEN_SIZE, hdr_name));
+    put_u16(b + 2, index16(mods->size / MOD_SIZE, hdr_name));
+
+    table_append(gens, GEN_SIZE);
+    table_append(mods, MOD_SIZE);
+}
+
+int main(int argc, char** argv) {
+    // -c <quality>: compress the samples (SF3)
+    int compress = argc > 2 && !strcmp(argv[1], "-c");
+    double quality = compress ? atof(argv[2]) : 0;
+    if (compress) {
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 3) {
+        fprintf(stderr, "Usage: sf2_subset [-c quality] <in.sf2> <out.sf2> [bank:program ...]\n");
+        return 1;
+    }
+    if (compress && !SF3) {
+        fprintf(stderr, "Sample compression needs an sf2_subset built with SF3=1\n");
+        return 1;
+    }
+    if (quality < 0 || quality > 1) {
+        fprintf(stderr, "Compression quality must be between 0.0 and 1.0\n");
+        return 1;
+    }
+    int select_count = argc - 3;
+    char** selections = argv + 3;
+
+    FILE* in = fopen(argv[1], "rb");
+    if (!in) {
+        perror("Failed to open input soundfont");
+        return 1;
+    }
+
+    SF2Hydra hydra;
+    char err[256];
+    if (sf2_hydra_read(in, &hydra, err, sizeof(err)) != 0) {
+        fprintf(stderr, "Failed to read soundfont structure: %s\n", err);
+        fclose(in);
+        return 1;
+    }
+
+    // Real records, without the terminal ones
+    uint32_t preset_count = hydra.phdr_count - 1;
+    uint32_t inst_count = hydra.inst_count - 1;
+    uint32_t sample_count = hydra.shdr_count - 1;
+
+    uint8_t* keep_preset = calloc(preset_count, 1);
+    uint8_t* keep_inst = calloc(inst_count ? inst_count : 1, 1);
+    uint8_t* keep_sample = calloc(sample_count ? sample_count : 1, 1);
+    uint32_t* inst_map = malloc((inst_count ? inst_count : 1) * sizeof(uint32_t));
+    uint32_t* sample_map = malloc((sample_count ? sample_count : 1) * sizeof(uint32_t));
+    uint32_t* sample_start = malloc((sample_count ? sample_count : 1) * sizeof(uint32_t));
+    uint32_t* sample_end = malloc((sample_count ? sample_count : 1) * sizeof(uint32_t));
+    if (!keep_preset || !keep_inst || !keep_sample || !inst_map || !sample_map || !sample_start ||
+        !sample_end) {
+        fprintf(stderr, "Out of memory\n");
+        return 1;
+    }
+
+    // Presets, then the instruments they use, then the samples those use
+    uint32_t kept_presets = 0;
+    for (uint32_t p = 0; p < preset_count; p++) {
+        if (!preset_selected(&hydra.phdr[p], select_count, selections)) continue;
+        keep_preset[p] = 1;
+        kept_presets++;
+        mark_links(hydra.pbag, hydra.pbag_count, hydra.pgen, hydra.pgen_count,
+                   hydra.phdr[p].bag_index, hydra.phdr[p + 1].bag_index,
+                   SF2_GEN_INSTRUMENT, keep_inst, inst_count);
+    }
+    if (kept_presets == 0) {
+        fprintf(stderr, "None of the selected presets exist in %s\n", argv[1]);
+        return 1;
+    }
+
+    for (uint32_t i = 0; i < inst_count; i++) {
+        if (!keep_inst[i]) continue;
+        mark_links(hydra.ibag, hydra.ibag_count, hydra.igen, hydra.igen_count,
+                   hydra.inst[i].bag_index, hydra.inst[i + 1].bag_index,
+                   SF2_GEN_SAMPLE_ID, keep_sample, sample_count);
+    }
+
+    // Keep both halves of stereo pairs
+    for (uint32_t s = 0; s < sample_count; s++) {
+        const SF2SampleHeader* h = &hydra.shdr[s];
+        if (keep_sample[s] && (h->sample_type & (SAMPLE_RIGHT | SAMPLE_LEFT | SAMPLE_LINKED)) &&
+            h->sample_link < sample_count) {
+            keep_sample[h->sample_link] = 1;
+        }
+    }
+
+    uint32_t kept_insts = 0, kept_samples = 0;
+    for (uint32_t i = 0; i < inst_count; i++) {
+        inst_map[i] = keep_inst[i] ? kept_insts++ : NONE;
+    }
+    for (uint32_t s = 0; s < sample_count; s++) {
+        sample_map[s] = keep_sample[s] ? kept_samples++ : NONE;
+    }
+
+    // Rewrite the preset and instrument tables
+    Table phdr = {0}, pbag = {0}, pmod = {0}, pgen = {0};
+    Table inst = {0}, ibag = {0}, imod = {0}, igen = {0}, shdr = {0};
+
+    for (uint32_t p = 0; p < preset_count; p++) {
+        if (!keep_preset[p]) continue;
+        const SF2PresetHeader* h = &hydra.phdr[p];
+        uint8_t* r = table_append(&phdr, PHDR_SIZE);
+        put_name(r, h->name);
+        put_u16(r + 20, h->preset);
+        put_u16(r + 22, h->bank);
+        put_u16(r + 24, index16(pbag.size / BAG_SIZE, "pbag"));
+        put_u32(r + 26, h->library);
+        put_u32(r + 30, h->genre);
+        put_u32(r + 34, h->morphology);
+        copy_zones(hydra.pbag, hydra.pbag_count, hydra.pgen, hydra.pgen_count,
+                   hydra.pmod, hydra.pmod_count, h->bag_index, hydra.phdr[p + 1].bag_index,
+                   SF2_GEN_INSTRUMENT, inst_map, inst_count, &pbag, &pgen, &pmod, "pbag");
+    }
+    terminate_tables(&phdr, PHDR_SIZE, "EOP", 0, 24, &pbag, &pgen, &pmod);
+
+    for (uint32_t i = 0; i < inst_count; i++) {
+        if (!keep_inst[i]) continue;
+        uint8_t* r = table_append(&inst, INST_SIZE);
+        put_name(r, hydra.inst[i].name);
+        put_u16(r + 20, index16(ibag.size / BAG_SIZE, "ibag"));
+        copy_zones(hydra.ibag, hydra.ibag_count, hydra.igen, hydra.igen_count,
+                   hydra.imod, hydra.imod_count, hydra.inst[i].bag_index, hydra.inst[i + 1].bag_index,
+                   SF2_GEN_SAMPLE_ID, sample_map, sample_count, &ibag, &igen, &imod, "ibag");
+    }
+    terminate_tables(&inst, INST_SIZE, "EOI", 0, 20, &ibag, &igen, &imod);
+
+    // Pack the kept samples; each is followed by zero guard points. When
+    // compressing, the encoded streams are collected in memory instead
+    uint64_t smpl_points = 0;
+    Table encoded = {0};
+    int16_t* pcm = NULL;
+    for (uint32_t s = 0; s < sample_count; s++) {
+        const SF2SampleHeader* h = &hydra.shdr[s];
+        if (!keep_sample[s] || (h->sample_type & SAMPLE_ROM)) continue;
+        if (!sample_copyable(&hydra, h)) {
+            fprintf(stderr, "Warning: sample %u (%s) is compressed or out of range, written empty\n",
+                    s, h->name);
+            sample_start[s] = compress ? (uint32_t)encoded.size : (uint32_t)smpl_points;
+            sample_end[s] = sample_start[s];
+            if (!compress) {
+                smpl_points += SF2_SAMPLE_GUARD_POINTS;
+            }
+            continue;
+        }
+#if SF3
+        if (compress) {
+            uint32_t frames = h->end - h->start;
+            int16_t* grown = realloc(pcm, (frames ? frames : 1) * sizeof(int16_t));
+            if (!grown) {
+                fprintf(stderr, "Out of memory\n");
+                return 1;
+            }
+            pcm = grown;
+            if (read_points(in, &hydra, h, pcm) != 0) {
+                fprintf(stderr, "Failed to read sample %u (%s)\n", s, h->name);
+                return 1;
+            }
+            sample_start[s] = (uint32_t)encoded.size;
+            if (encode_vorbis(pcm, frames, h->sample_rate, quality, &encoded) != 0) {
+                fprintf(stderr, "Failed to compress sample %u (%s)\n", s, h->name);
+                return 1;
+            }
+            if (encoded.size > UINT32_MAX - 4096) {
+                fprintf(stderr, "Subset sample data exceeds the 4 GB chunk limit\n");
+                return 1;
+            }
+            sample_end[s] = (uint32_t)encoded.size;
+            continue;
+        }
+#endif
+        sample_start[s] = (uint32_t)smpl_points;
+        smpl_points += (h->end - h->start) + SF2_SAMPLE_GUARD_POINTS;
+        if (smpl_points * 2 > UINT32_MAX - 4096) {
+            fprintf(stderr, "Subset sample data exceeds the 4 GB chunk limit\n");
+            return 1;
+        }
+    }
+
+    for (uint32_t s = 0; s < sample_count; s++) {
+        if (!keep_sample[s]) continue;
+        const SF2SampleHeader* h = &hydra.shdr[s];
+        uint8_t* r = table_append(&shdr, SHDR_SIZE);
+        put_name(r, h->name);
+        if (h->sample_type & SAMPLE_ROM) {
+            // ROM samples are addressed in the ROM, keep them unchanged
+            put_u32(r + 20, h->start);
+            put_u32(r + 24, h->end);
+            put_u32(r + 28, h->loop_start);
+            put_u32(r + 32, h->loop_end);
+        } else if (!sample_copyable(&hydra, h)) {
+            // Empty, with its loop collapsed onto the start
+            uint32_t loop = compress ? 0 : sample_start[s];
+            put_u32(r + 20, sample_start[s]);
+            put_u32(r + 24, sample_end[s]);
+            put_u32(r + 28, loop);
+            put_u32(r + 32, loop);
+        } else {
+            // Loop points move with the sample. Compressed samples are
+            // addressed in bytes, and their loop points are relative to the
+            // start of the sample
+            uint32_t base = compress ? 0 : sample_start[s];
+            uint32_t loop_start, loop_end;
+            if (move_point(h, h->loop_start, base, &loop_start) != 0 ||
+                move_point(h, h->loop_end, base, &loop_end) != 0) {
+                fprintf(stderr, "Cannot subset sample %u (%s): loop out of range\n", s, h->name);
+                return 1;
+            }
+            put_u32(r + 20, sample_start[s]);
+            put_u32(r + 24, compress ? sample_end[s] : base + (h->end - h->start));
+            put_u32(r + 28, loop_start);
+            put_u32(r + 32, loop_end);
+        }
+        put_u32(r + 36, h->sample_rate);
+        r[40] = h->original_pitch;
+        r[41] = (uint8_t)h->pitch_correction;
+        uint32_t link = h->sample_link < sample_count ? sample_map[h->sample_link] : NONE;
+        put_u16(r + 42, link != NONE ? (uint16_t)link : 0);
+        // ROM samples keep their type; the others are compressed exactly
+        // when the output is, including input samples written empty
+        uint16_t type = h->sample_type;
+        if (!(type & SAMPLE_ROM)) {
+            type = (uint16_t)((type & ~SAMPLE_COMPRESSED) | (compress ? SAMPLE_COMPRESSED : 0));
+        }
+        put_u16(r + 44, type);
+    }
+    {
+        uint8_t* r = table_append(&shdr, SHDR_SIZE);
+        put_name(r, "EOS");
+    }
+
+    // Chunk sizes: RIFF sfbk { LIST INFO, LIST sdta { smpl }, LIST pdta { 9 tables } }
+    if (encoded.size & 1) table_append(&encoded, 1); // keep the smpl chunk even
+    uint32_t smpl_size = compress ? (uint32_t)encoded.size : (uint32_t)(smpl_points * 2);
+    uint32_t info_list = 4 + hydra.info_size;
+    uint32_t sdta_list = 4 + 8 + smpl_size;
+    Table* tables[] = { &phdr, &pbag, &pmod, &pgen, &inst, &ibag, &imod, &igen, &shdr };
+    const char* table_ids[] = { "phdr", "pbag", "pmod", "pgen", "inst", "ibag", "imod", "igen", "shdr" };
+    uint32_t pdta_list = 4;
+    for (int t = 0; t < 9; t++) {
+        pdta_list += 8 + (uint32_t)tables[t]->size; // all record sizes are even
+    }
+    uint32_t riff_size = 4 + (8 + info_list + (info_list & 1)) + (8 + sdta_list) + (8 + pdta_list);
+
+    FILE* out = fopen(argv[2], "wb");
+    if (!out) {
+        perror("Failed to create output soundfont");
+        return 1;
+    }
+
+    write_chunk_header(out, "RIFF", riff_size);
+    fwrite("sfbk", 1, 4, out);
+
+    // INFO list, copied unchanged except for the version of SF3 output
+    write_chunk_header(out, "LIST", info_list);
+    fwrite("INFO", 1, 4, out);
+    Table info = {0};
+    uint8_t* info_data = table_append(&info, hydra.info_size);
+    fseeko(in, (off_t)hydra.info_offset, SEEK_SET);
+    if (fread(info_data, 1, hydra.info_size, in) != hydra.info_size) {
+        fprintf(stderr, "Failed to read INFO list\n");
+        return 1;
+    }
+    if (compress) {
+        set_info_version(info_data, info.size, 3);
+    }
+    fwrite(info_data, 1, info.size, out);
+    free(info.data);
+    if (info_list & 1) fputc(0, out);
+
+    // Sample data
+    write_chunk_header(out, "LIST", sdta_list);
+    fwrite("sdta", 1, 4, out);
+    write_chunk_header(out, "smpl", smpl_size);
+    if (compress) {
+        fwrite(encoded.data, 1, encoded.size, out);
+    }
+    static uint8_t buffer[1 << 20];
+    for (uint32_t s = 0; s < sample_count && !compress; s++) {
+        const SF2SampleHeader* h = &hydra.shdr[s];
+        if (!keep_sample[s] || (h->sample_type & SAMPLE_ROM)) continue;
+        uint64_t bytes = sample_copyable(&hydra, h) ? (uint64_t)(h->end - h->start) * 2 : 0;
+        fseeko(in, (off_t)(hydra.smpl_offset + (uint64_t)h->start * 2), SEEK_SET);
+        while (bytes > 0) {
+            size_t n = bytes < sizeof(buffer) ? (size_t)bytes : sizeof(buffer);
+            if (fread(buffer, 1, n, in) != n) {
+                fprintf(stderr, "Failed to read sample %u (%s)\n", s, h->name);
+                return 1;
+            }
+            fwrite(buffer, 1, n, out);
+            bytes -= n;
+        }
+        static const uint8_t guard[SF2_SAMPLE_GUARD_POINTS * 2];
+        fwrite(guard, 1, sizeof(guard), out);
+    }
+
+    // Preset data
+    write_chunk_header(out, "LIST", pdta_list);
+    fwrite("pdta", 1, 4, out);
+    for (int t = 0; t < 9; t++) {
+        write_chunk_header(out, table_ids[t], (uint32_t)tables[t]->size);
+        fwrite(tables[t]->data, 1, tables[t]->size, out);
+        free(tables[t]->data);
+    }
+
+    int failed = ferror(out);
+    if (fclose(out) != 0 || failed) {
+        perror("Failed to write output soundfont");
+        return 1;
+    }
+    fclose(in);
+
+    fprintf(stderr, "Subset: kept %u/%u presets, %u/%u instruments, %u/%u samples; "
+                    "sample data %u -> %u bytes%s%s\n",
+            kept_presets, preset_count, kept_insts, inst_count, kept_samples, sample_count,
+            hydra.smpl_size, smpl_size, compress ? " (Ogg Vorbis)" : "",
+            hydra.sm24_size ? " (sm24 dropped)" : "");
+
+    sf2_hydra_free(&hydra);
+    free(keep_preset);
+    free(keep_inst);
+    free(keep_sample);
+    free(inst_map);
+    free(sample_map);
+    free(sample_start);
+    free(sample_end);
+    free(encoded.data);
+    free(pcm);
+    return 0;
+}
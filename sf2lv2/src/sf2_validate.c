@@ -0,0 +1,198 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * SoundFont validator (sf2_validate.c)
+ *
+ * Checks the structure of an uploaded SoundFont before a build is queued,
+ * so malformed or truncated files are rejected without starting a builder:
+ * 1. Walks the RIFF sfbk chunks (INFO, sdta, pdta) and checks their sizes
+ * 2. Checks every zone, generator and modulator index of the preset and
+ *    instrument tables against the table it points into
+ * 3. Checks the sample headers against the size of the sample data.
+ *    Samples FluidSynth merely disables (bad bounds, no sample rate) are
+ *    reported as warnings, since such files still convert and play
+ * Sample data is never read, so validation takes milliseconds even for
+ * very large files.
+ *
+ * Usage: sf2_validate <soundfont.sf2>
+ * Exit status: 0 if valid, 1 if invalid (reason on stderr), 2 on usage or
+ * I/O errors.
+ */
+
+#include <stdio.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "sf2_hydra.h"
+
+/* Sample type flags (SoundFont 2.04, section 7.10; bit 4 is the SF3
+   compressed-sample extension) */
+#define SF2_SAMPLE_ROM        0x8000
+#define SF2_SAMPLE_COMPRESSED 0x10
+
+/* Print a validation error and return -1 */
+static int invalid(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "Invalid SoundFont: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+    return -1;
+}
+
+/* Check the zone lists of a preset or instrument table: the first zone of
+   each header must not decrease and must be a real zone; only the terminal
+   header may point just past the last one */
+static int check_headers(const char* table, uint32_t count, const uint16_t* first_bag,
+                         size_t stride, uint32_t bag_count) {
+    uint16_t prev = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        uint16_t bag = *(const uint16_t*)((const uint8_t*)first_bag + i * stride);
+        if (bag < prev) {
+            return invalid("%s record %u has zone index %u below the previous record's %u",
+                           table, i, bag, prev);
+        }
+        bool terminal = (i + 1 == count);
+        if (terminal ? bag > bag_count : bag >= bag_count) {
+            return invalid("%s record %u has zone index %u, but there are only %u zones",
+                           table, i, bag, bag_count);
+        }
+        prev = bag;
+    }
+    return 0;
+}
+
+/* Same check for a zone table and the generators and modulators it points into */
+static int check_bags(const char* table, const SF2Bag* bags, uint32_t count,
+                      uint32_t gen_count, uint32_t mod_count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (i > 0 && (bags[i].gen_index < bags[i - 1].gen_index ||
+                      bags[i].mod_index < bags[i - 1].mod_index)) {
+            return invalid("%s zone %u starts before the previous zone", table, i);
+        }
+        if (bags[i].gen_index > gen_count) {
+            return invalid("%s zone %u has generator index %u, but there are only %u generators",
+                           table, i, bags[i].gen_index, gen_count);
+        }
+        if (bags[i].mod_index > mod_count) {
+            return invalid("%s zone %u has modulator index %u, but there are only %u modulators",
+                           table, i, bags[i].mod_index, mod_count);
+        }
+    }
+    return 0;
+}
+
+/* Check the generators that link zones to other tables (instrument and
+   sample IDs) point at real records, not past the terminal one */
+static int check_links(const char* table, const SF2Gen* gens, uint32_t count,
+                       uint16_t oper, const char* target, uint32_t target_count) {
+    for (uint32_t i = 0; i < count; i++) {
+        if (gens[i].oper == oper && gens[i].amount + 1u >= target_count) {
+            return invalid("%s generator %u refers to %s %u, but there are only %u",
+                           table, i, target, gens[i].amount, target_count - 1);
+        }
+    }
+    return 0;
+}
+
+/* Print a validation warning */
+static void warning(const char* fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    fprintf(stderr, "Warning: ");
+    vfprintf(stderr, fmt, args);
+    fprintf(stderr, "\n");
+    va_end(args);
+}
+
+/* Check the sample headers lie within the sample data. FluidSynth only warns
+   about samples that do not and leaves them silent, so these are warnings.
+   Returns: the number of such samples */
+static uint32_t check_samples(const SF2Hydra* hydra) {
+    uint32_t bad = 0;
+    // 16-bit sample points in the smpl chunk
+    uint64_t points = hydra->smpl_size / 2;
+
+    for (uint32_t i = 0; i + 1 < hydra->shdr_count; i++) {
+        const SF2SampleHeader* s = &hydra->shdr[i];
+        if (s->sample_type & SF2_SAMPLE_ROM) {
+            continue; // data lives in a ROM, not in this file
+        }
+        // Compressed (SF3) samples are addressed in bytes
+        uint64_t limit = (s->sample_type & SF2_SAMPLE_COMPRESSED) ? hydra->smpl_size : points;
+        if (s->start > s->end) {
+            warning("sample %u (%s) ends before it starts and will be silent", i, s->name);
+            bad++;
+        } else if (s->end > limit) {
+            warning("sample %u (%s) ends at %u, past the end of the sample data (%llu), and will be silent",
+                    i, s->name, s->end, (unsigned long long)limit);
+            bad++;
+        } else if (s->sample_rate == 0) {
+            warning("sample %u (%s) has a sample rate of 0 and will be silent", i, s->name);
+            bad++;
+        }
+    }
+    return bad;
+}
+
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s <soundfont.sf2>\n", argv[0]);
+        return 2;
+    }
+
+    FILE* file = fopen(argv[1], "rb");
+    if (!file) {
+        perror("Failed to open soundfont");
+        return 2;
+    }
+
+    SF2Hydra hydra;
+    char err[256];
+    int result = sf2_hydra_read(file, &hydra, err, sizeof(err));
+    fclose(file);
+    if (result != 0) {
+        invalid("%s", err);
+        return 1;
+    }
+
+    if (hydra.version_major != 2 && hydra.version_major != 3) {
+        result = invalid("unsupported version %u.%u", hydra.version_major, hydra.version_minor);
+    }
+    if (result == 0) {
+        result = check_headers("phdr", hydra.phdr_count, &hydra.phdr[0].bag_index,
+                               sizeof(SF2PresetHeader), hydra.pbag_count);
+    }
+    if (result == 0) {
+        result = check_bags("pbag", hydra.pbag, hydra.pbag_count, hydra.pgen_count, hydra.pmod_count);
+    }
+    if (result == 0) {
+        result = check_links("pgen", hydra.pgen, hydra.pgen_count, SF2_GEN_INSTRUMENT,
+                             "instrument", hydra.inst_count);
+    }
+    if (result == 0) {
+        result = check_headers("inst", hydra.inst_count, &hydra.inst[0].bag_index,
+                               sizeof(SF2Inst), hydra.ibag_count);
+    }
+    if (result == 0) {
+        result = check_bags("ibag", hydra.ibag, hydra.ibag_count, hydra.igen_count, hydra.imod_count);
+    }
+    if (result == 0) {
+        result = check_links("igen", hydra.igen, hydra.igen_count, SF2_GEN_SAMPLE_ID,
+                             "sample", hydra.shdr_count);
+    }
+    if (result == 0) {
+        uint32_t bad_samples = check_samples(&hydra);
+        printf("OK: SoundFont %u.%u, %u presets, %u instruments, %u samples",
+               hydra.version_major, hydra.version_minor,
+               hydra.phdr_count - 1, hydra.inst_count - 1, hydra.shdr_count - 1);
+        if (bad_samples > 0) {
+            printf(" (%u unplayable)", bad_samples);
+        }
+        printf("\n");
+    }
+
+    sf2_hydra_free(&hydra);
+    return result == 0 ? 0 : 1;
+}
@@ -0,0 +1,252 @@
+/*
+ * SF2LV2 - SoundFont to LV2 Plugin Generator
+ * Subsetter Check (subset_test.c)
+ *
+ * Runs the SoundFont subsetter on a generated fixture and checks the result:
+ * 1. Writes a SoundFont whose samples are stored out of order - the first
+ *    sample header points behind the second in the sample data - so the
+ *    first sample moves down and the second moves up when they are packed
+ *    A third sample ends past the sample data
+ * 2. Subsets it with sf2_subset
+ * 3. Checks that every sample's end and loop points moved with its start,
+ *    and that its data points came along; the broken sample must be kept,
+ *    written empty
+ *
+ * Usage: subset_test <sf2_subset> <work dir>
+ */
+
+#include "sf2_hydra.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Fixture samples, in shdr order */
+typedef struct {
+    const char* name;
+    uint32_t start, end, loop_start, loop_end;
+    int empty;          // Out of range; the subset keeps it without data
+} FixtureSample;
+
+static const FixtureSample fixture[] = {
+    {"High", 100, 150, 110, 140, 0},
+    {"Low", 0, 50, 10, 40, 0},
+    {"Broken", 120, 5000, 130, 4000, 1},
+};
+#define FIXTURE_SAMPLES 3
+#define FIXTURE_POINTS (150 + SF2_SAMPLE_GUARD_POINTS)
+
+static void write_u16(FILE* out, uint16_t v) {
+    uint8_t b[2] = {v & 0xff, v >> 8};
+    fwrite(b, 1, 2, out);
+}
+
+static void write_u32(FILE* out, uint32_t v) {
+    uint8_t b[4] = {v & 0xff, (v >> 8) & 0xff, (v >> 16) & 0xff, v >> 24};
+    fwrite(b, 1, 4, out);
+}
+
+static void write_chunk_header(FILE* out, const char* id, uint32_t size) {
+    fwrite(id, 1, 4, out);
+    write_u32(out, size);
+}
+
+static void write_name(FILE* out, const char* name) {
+    char padded[20] = {0};
+    size_t len = strlen(name);
+    memcpy(padded, name, len < sizeof(padded) ? len : sizeof(padded));
+    fwrite(padded, 1, sizeof(padded), out);
+}
+
+static void write_zeros(FILE* out, size_t n) {
+    while (n--) fputc(0, out);
+}
+
+/* One preset with one instrument, which plays every fixture sample */
+static int write_fixture(const char* path) {
+    FILE* out = fopen(path, "wb");
+    if (!out) {
+        perror("Failed to create fixture");
+        return -1;
+    }
+    uint32_t info_size = 4 + 8 + 4;
+    uint32_t smpl_size = FIXTURE_POINTS * 2;
+    uint32_t sdta_size = 4 + 8 + smpl_size;
+    uint32_t sizes[9] = {
+        2 * 38, 2 * 4, 10, 2 * 4,                       // phdr pbag pmod pgen
+        2 * 22, (FIXTURE_SAMPLES + 1) * 4, 10,          // inst ibag imod
+        (FIXTURE_SAMPLES + 1) * 4, (FIXTURE_SAMPLES + 1) * 46  // igen shdr
+    };
+    uint32_t pdta_size = 4;
+    for (int t = 0; t < 9; t++) pdta_size += 8 + sizes[t];
+
+    write_chunk_header(out, "RIFF", 4 + 8 + info_size + 8 + sdta_size + 8 + pdta_size);
+    fwrite("sfbk", 1, 4, out);
+
+    write_chunk_header(out, "LIST", info_size);
+    fwrite("INFO", 1, 4, out);
+    write_chunk_header(out, "ifil", 4);
+    write_u16(out, 2);
+    write_u16(out, 1);
+
+    // Every data point holds its own index + 1, so moved data can be traced
+    write_chunk_header(out, "LIST", sdta_size);
+    fwrite("sdta", 1, 4, out);
+    write_chunk_header(out, "smpl", smpl_size);
+    for (uint32_t i = 0; i < FIXTURE_POINTS; i++) {
+        write_u16(out, i < 150 ? (uint16_t)(i + 1) : 0);
+    }
+
+    write_chunk_header(out, "LIST", pdta_size);
+    fwrite("pdta", 1, 4, out);
+    write_chunk_header(out, "phdr", sizes[0]);
+    write_name(out, "Test");
+    write_u16(out, 0);
+    write_u16(out, 0);
+    write_u16(out, 0);
+    write_zeros(out, 12);
+    write_name(out, "EOP");
+    write_zeros(out, 4);
+    write_u16(out, 1);
+    write_zeros(out, 12);
+
+    write_chunk_header(out, "pbag", sizes[1]);
+    write_u16(out, 0);
+    write_u16(out, 0);
+    write_u16(out, 1);
+    write_u16(out, 0);
+    write_chunk_header(out, "pmod", sizes[2]);
+    write_zeros(out, 10);
+    write_chunk_header(out, "pgen", sizes[3]);
+    write_u16(out, SF2_GEN_INSTRUMENT);
+    write_u16(out, 0);
+    write_zeros(out, 4);
+
+    write_chunk_header(out, "inst", sizes[4]);
+    write_name(out, "Test");
+    write_u16(out, 0);
+    write_name(out, "EOI");
+    write_u16(out, FIXTURE_SAMPLES);
+    write_chunk_header(out, "ibag", sizes[5]);
+    for (uint16_t z = 0; z <= FIXTURE_SAMPLES; z++) {
+        write_u16(out, z);
+        write_u16(out, 0);
+    }
+    write_chunk_header(out, "imod", sizes[6]);
+    write_zeros(out, 10);
+    write_chunk_header(out, "igen", sizes[7]);
+    for (uint16_t s = 0; s < FIXTURE_SAMPLES; s++) {
+        write_u16(out, SF2_GEN_SAMPLE_ID);
+        write_u16(out, s);
+    }
+    write_zeros(out, 4);
+
+    write_chunk_header(out, "shdr", sizes[8]);
+    for (int s = 0; s < FIXTURE_SAMPLES; s++) {
+        write_name(out, fixture[s].name);
+        write_u32(out, fixture[s].start);
+        write_u32(out, fixture[s].end);
+        write_u32(out, fixture[s].loop_start);
+        write_u32(out, fixture[s].loop_end);
+        write_u32(out, 44100);
+        fputc(60, out);
+        fputc(0, out);
+        write_u16(out, 0);
+        write_u16(out, 1);
+    }
+    write_name(out, "EOS");
+    write_zeros(out, 26);
+
+    if (fclose(out) != 0) {
+        perror("Failed to write fixture");
+        return -1;
+    }
+    return 0;
+}
+
+/* Check the subset's sample headers and data against the fixture */
+static int check_subset(const char* path) {
+    FILE* in = fopen(path, "rb");
+    if (!in) {
+        perror("Failed to open subset");
+        return -1;
+    }
+    SF2Hydra hydra;
+    char err[256];
+    if (sf2_hydra_read(in, &hydra, err, sizeof(err)) != 0) {
+        fprintf(stderr, "Failed to read subset: %s\n", err);
+        fclose(in);
+        return -1;
+    }
+    int failures = 0;
+    if (hydra.shdr_count != FIXTURE_SAMPLES + 1) {
+        fprintf(stderr, "Expected %d samples, found %u\n", FIXTURE_SAMPLES, hydra.shdr_count - 1);
+        failures++;
+    }
+    for (uint32_t s = 0; s < FIXTURE_SAMPLES && s + 1 < hydra.shdr_count; s++) {
+        const FixtureSample* f = &fixture[s];
+        const SF2SampleHeader* h = &hydra.shdr[s];
+        if (f->empty) {
+            if (h->end != h->start || h->loop_start != h->start || h->loop_end != h->start) {
+                fprintf(stderr, "Sample %s: points %u-%u loop %u-%u, expected an empty sample\n",
+                        f->name, h->start, h->end, h->loop_start, h->loop_end);
+                failures++;
+            }
+            continue;
+        }
+        // Points relative to the start must survive the move
+        if (h->end < h->start || h->end - h->start != f->end - f->start ||
+            h->loop_start - h->start != f->loop_start - f->start ||
+            h->loop_end - h->start != f->loop_end - f->start) {
+            fprintf(stderr, "Sample %s: points %u-%u loop %u-%u do not match %u-%u loop %u-%u\n",
+                    f->name, h->start, h->end, h->loop_start, h->loop_end,
+                    f->start, f->end, f->loop_start, f->loop_end);
+            failures++;
+            continue;
+        }
+        if ((uint64_t)h->end * 2 > hydra.smpl_size) {
+            fprintf(stderr, "Sample %s: end %u is past the sample data\n", f->name, h->end);
+            failures++;
+            continue;
+        }
+        fseek(in, (long)(hydra.smpl_offset + (uint64_t)h->start * 2), SEEK_SET);
+        for (uint32_t i = 0; i < h->end - h->start; i++) {
+            int lo = fgetc(in), hi = fgetc(in);
+            if (lo == EOF || hi == EOF || (uint32_t)(lo | (hi << 8)) != f->start + i + 1) {
+                fprintf(stderr, "Sample %s: data point %u did not move with the sample\n", f->name, i);
+                failures++;
+                break;
+            }
+        }
+    }
+    sf2_hydra_free(&hydra);
+    fclose(in);
+    return failures ? -1 : 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: subset_test <sf2_subset> <work dir>\n");
+        return 1;
+    }
+    char fixture_path[4096], subset_path[4096], command[12288];
+    snprintf(fixture_path, sizeof(fixture_path), "%s/subset_fixture.sf2", argv[2]);
+    snprintf(subset_path, sizeof(subset_path), "%s/subset_result.sf2", argv[2]);
+    if (write_fixture(fixture_path) != 0) {
+        return 1;
+    }
+    snprintf(command, sizeof(command), "'%s' '%s' '%s'", argv[1], fixture_path, subset_path);
+    if (system(command) != 0) {
+        fprintf(stderr, "FAIL: sf2_subset rejected the out-of-order fixture\n");
+        return 1;
+    }
+    if (check_subset(subset_path) != 0) {
+        fprintf(stderr, "FAIL: subset samples do not match the fixture\n");
+        return 1;
+    }
+    remove(fixture_path);
+    remove(subset_path);
+    printf("OK: out-of-order samples keep their points and data, broken ones are kept empty\n");
+    return 0;
+}
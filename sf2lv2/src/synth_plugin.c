@@ -22,19 +22,40 @@
 #include <lv2/atom/util.h>         // Utility functions for atom handling
 #include <lv2/midi/midi.h>         // MIDI event definitions
 #include <lv2/urid/urid.h>         // URI mapping functionality
+#include <lv2/worker/worker.h>     // Non-realtime work scheduling
+#include <lv2/options/options.h>   // Instantiation options
+#include <lv2/state/state.h>       // Saving and restoring plugin state
 
 // FluidSynth header for SoundFont synthesis
 #include <fluidsynth.h>
 
+// Binary preset index written by the metadata generator
+#include "preset_index.h"
+
+// URIs of our instantiation options
+#include "plugin_uris.h"
+
+// Plugin URI and name, read from the bundle
+#include "bundle_desc.h"
+
 // Standard C library headers
 #include <stdlib.h>                // For memory allocation
 #include <string.h>                // For string operations
 #include <stdio.h>                 // For debug output
 #include <math.h>                  // For mathematical operations
 #include <unistd.h>                // For getcwd() function
+#include <limits.h>                // For PATH_MAX
+#include <pthread.h>               // For the shared SoundFont cache lock
+#include <fcntl.h>                 // For open() in the mmap loader
+#include <sys/mman.h>              // For mmap() in the mmap loader
+#include <sys/stat.h>              // For fstat() in the mmap loader
+#include <time.h>                  // For clock_gettime() in the voice governor
+#include <stdatomic.h>             // For the command ring
 
-/* Plugin name and SF2 file are defined at compile time.
-   If not defined, use "undefined" as fallback values */
+/* The plugin URI and name normally come from the bundle descriptor file
+   (see bundle_desc.h), so one binary serves every SoundFont. PLUGIN_NAME
+   only names the fallback descriptor for hosts that use lv2_descriptor()
+   or bundles without a descriptor file; "undefined" if not defined */
 #ifndef PLUGIN_NAME
 #define PLUGIN_NAME "undefined"
 #endif
@@ -43,14 +64,140 @@
 #define SF2_FILE "soundfont.sf2"
 #endif
 
-// Display name used for logging and debugging
-static const char* PLUGIN_DISPLAY_NAME = PLUGIN_NAME;
+// URI of the fallback descriptor
+#define PLUGIN_URI SF2LV2_URI "/" PLUGIN_NAME
+
+/* Maximum number of frames rendered per fluid_synth_write_float() call.
+   FluidSynth already renders internally in 64-frame blocks, so the default
+   of 0 hands each span to FluidSynth in one call. Can be overridden at
+   compile time (see makefile) */
+#ifndef BUFFER_SIZE
+#define BUFFER_SIZE 0
+#endif
+
+/* Sample-accurate event scheduling. When enabled, run() splits rendering at
+   each MIDI event's frame offset instead of applying every event at frame 0.
+   MIN_SUBBLOCK is the smallest span rendered between two split points; events
+   closer together than that are applied at the start of the current span.
+   Both can be overridden at compile time (see makefile) */
+#ifndef SAMPLE_ACCURATE
+#define SAMPLE_ACCURATE 1
+#endif
 
-// Unique URI for the plugin, used by LV2 hosts to identify the plugin
-#define PLUGIN_URI "https://github.com/islainstruments/sf2lv2/" PLUGIN_NAME
+#ifndef MIN_SUBBLOCK
+#define MIN_SUBBLOCK 16
+#endif
 
-// Size of audio processing buffer for FluidSynth
-#define BUFFER_SIZE 64
+/* Lazy sample loading. When enabled, the SoundFont is memory-mapped instead
+   of read through stdio, and FluidSynth's dynamic sample loading only pulls
+   in the samples of presets that are actually selected. Startup time and
+   resident memory then track the presets in use rather than the file size.
+   Off by default; enable at compile time (see makefile) */
+#ifndef LAZY_SAMPLES
+#define LAZY_SAMPLES 0
+#endif
+
+/* Multi-timbral mode. When enabled, MIDI messages keep their channel, so one
+   instance plays up to 16 parts from a single synth and sample pool, and
+   program change and bank select are honoured per channel. The control ports
+   (program, cutoff, ADSR...) then address MIDI channel 1 only.
+   CHANNEL_OUTPUTS additionally exposes a stereo output pair per MIDI channel;
+   the main outputs carry the mix of all channels.
+   Both off by default; enable at compile time (see makefile) */
+#ifndef MULTITIMBRAL
+#define MULTITIMBRAL 0
+#endif
+
+#ifndef CHANNEL_OUTPUTS
+#define CHANNEL_OUTPUTS 0
+#endif
+
+#if CHANNEL_OUTPUTS && !MULTITIMBRAL
+#error "CHANNEL_OUTPUTS requires MULTITIMBRAL"
+#endif
+
+/* Default voice and thread counts. Hosts can override them per instance
+   through the LV2 options feature (see plugin_uris.h). CPU_CORES above 1
+   makes FluidSynth render on its own worker threads, beside the threads the
+   host already schedules, so it defaults to 1 */
+#ifndef POLYPHONY
+#define POLYPHONY 64
+#endif
+
+#ifndef CPU_CORES
+#define CPU_CORES 1
+#endif
+
+/* Voice governor. When DSP_BUDGET is non-zero, run() measures its own cost
+   as a percentage of the period and lowers the synth's polyphony as soon as
+   a cycle exceeds the budget, then raises it again step by step while the
+   load stays well below. Polyphony never goes above the allocated maximum,
+   so changing it does not allocate. Off by default; set at compile time
+   (see makefile) or per instance with the dspBudget option */
+#ifndef DSP_BUDGET
+#define DSP_BUDGET 0
+#endif
+
+#define GOVERNOR_MIN_VOICES  8     // Never govern below this many voices
+#define GOVERNOR_MARGIN      0.9f  // Headroom kept when cutting voices
+#define GOVERNOR_RAISE_LOAD  0.7f  // Raise when the average load is below this share of the budget
+#define GOVERNOR_RAISE_STEPS 16    // Raise by 1/16 of the maximum at a time...
+#define GOVERNOR_RAISE_HOLD  0.25  // ...after this many calm seconds
+#define GOVERNOR_SMOOTHING   0.1f  // Weight of the latest cycle in the average load
+
+/* Performance counters. When enabled, the plugin has control output ports
+   reporting the active voice count, note-ons that had to steal a voice, the
+   CPU time of the last and slowest run() as a percentage of the period, and
+   the MIDI events handled in the last cycle. run() only stores numbers in
+   them, so hosts can meter and log them in real time.
+   Off by default; enable at compile time (see makefile) */
+#ifndef PERF_PORTS
+#define PERF_PORTS 0
+#endif
+
+/* Idle fast path. Once no voice has sounded for IDLE_TAIL_MS, run() writes
+   silence without calling into FluidSynth until a MIDI event arrives or a
+   control port changes. The tail covers anything still decaying after the
+   last voice ends. On by default; can be disabled at compile time
+   (see makefile) */
+#ifndef IDLE_SKIP
+#define IDLE_SKIP 1
+#endif
+
+#ifndef IDLE_TAIL_MS
+#define IDLE_TAIL_MS 100
+#endif
+
+/* Lock-free synth access. FluidSynth's thread-safe API takes a mutex in every
+   call, including each note and controller event in run(). Program changes
+   already reach the synth from the audio thread only (the worker loads the
+   samples, then hands the change to run() through the command ring), so with
+   LOCKFREE_API the mutex is turned off altogether. Off by default; enable at
+   compile time (see makefile) */
+#ifndef LOCKFREE_API
+#define LOCKFREE_API 0
+#endif
+
+/* Decoded SF3 SoundFonts kept in memory after their last instance goes away.
+   Beyond this count the least recently used idle one is freed. Defaults to 2;
+   can be changed at compile time (see makefile) */
+#ifndef RETAINED_SFONTS
+#define RETAINED_SFONTS 2
+#endif
+
+#define COMMAND_RING_SIZE 256  // Commands queued for run(); a power of two
+#define PRELOAD_CHANNELS 256   // Owner synth channels holding preloaded presets
+
+// Number of MIDI channels, and the one FluidSynth uses for drum kits (channel 10)
+#define MIDI_CHANNELS 16
+#define DRUM_CHANNEL  9
+
+// Channel a MIDI message is played on
+#if MULTITIMBRAL
+#define MIDI_CHANNEL(msg) ((msg)[0] & 0x0F)
+#else
+#define MIDI_CHANNEL(msg) 0
+#endif
 
 /* MIDI CC numbers for sound parameters - these match standard MIDI CC assignments
    for common synthesizer controls */
@@ -61,13 +208,34 @@ static const char* PLUGIN_DISPLAY_NAME = PLUGIN_NAME;
 #define CC_SUSTAIN   70  // Sustain level (Sound Controller 1)
 #define CC_RELEASE   72  // Release time
 
+// Channels whose state is saved: only channel 1 plays unless MULTITIMBRAL
+#define STATE_CHANNELS (MULTITIMBRAL ? MIDI_CHANNELS : 1)
+
+// Layout of one channel in the saved sf2lv2:channels vector
+enum {
+    CHANNEL_STATE_BANK,
+    CHANNEL_STATE_PROGRAM,
+    CHANNEL_STATE_PITCH_BEND,
+    CHANNEL_STATE_WHEEL_SENS,
+    CHANNEL_STATE_CC,                          // First of the 128 controller values
+    CHANNEL_STATE_SIZE = CHANNEL_STATE_CC + 128
+};
+
 /* Structure to store bank/program pairs for SoundFont presets.
    Each preset in a SoundFont is identified by a bank and program number */
 typedef struct {
     int bank;   // MIDI bank number (0-128)
     int prog;   // MIDI program number (0-127)
+    uint32_t first_range;  // First entry of the preset's sample byte ranges
+    uint32_t range_count;  // Number of sample byte ranges (0 if unknown)
 } BankProgram;
 
+/* Byte range of the SoundFont file holding sample data, from the preset index */
+typedef struct {
+    uint64_t offset;  // File offset
+    uint64_t length;  // Length in bytes
+} PresetRange;
+
 /* Port indices for the plugin's inputs and outputs.
    These must match the TTL file port definitions */
 typedef enum {
@@ -81,21 +249,613 @@ typedef enum {
     PORT_ATTACK = 7,      // Envelope attack control (0.0 to 1.0)
     PORT_DECAY = 8,       // Envelope decay control (0.0 to 1.0)
     PORT_SUSTAIN = 9,     // Envelope sustain control (0.0 to 1.0)
-    PORT_RELEASE = 10     // Envelope release control (0.0 to 1.0)
+    PORT_RELEASE = 10,    // Envelope release control (0.0 to 1.0)
+    PORT_CHANNEL_OUT = 11 // First per-channel output (CHANNEL_OUTPUTS only).
+                          // Channel n (0-15) uses ports 11 + 2n (left) and 12 + 2n (right)
 } PortIndex;
 
+/* Performance counter outputs (PERF_PORTS only), after any per-channel outputs */
+#define PORT_PERF_FIRST (PORT_CHANNEL_OUT + (CHANNEL_OUTPUTS ? 2 * MIDI_CHANNELS : 0))
+
+typedef enum {
+    PERF_VOICES = 0,      // Active voices at the end of the cycle
+    PERF_VOICE_STEALS,    // Note-ons that found every voice busy, since activation
+    PERF_LOAD,            // CPU time of the last run(), in percent of the period
+    PERF_PEAK_LOAD,       // Highest PERF_LOAD since activation
+    PERF_EVENTS,          // MIDI events handled in the last run()
+    PERF_PORT_COUNT
+} PerfPort;
+
+/* Upper bounds the TTL declares for the counters (perf_ports[] in
+   ttl_generator.c); values are clamped to them before they are written.
+   Voices go up to the largest polyphony the option accepts, and the load
+   leaves room to show overruns */
+static const float perf_maximum[PERF_PORT_COUNT] = {
+    [PERF_VOICES] = 65535.0f,
+    [PERF_VOICE_STEALS] = 1000000.0f,
+    [PERF_LOAD] = 1000.0f,
+    [PERF_PEAK_LOAD] = 1000.0f,
+    [PERF_EVENTS] = 1024.0f,
+};
+
 /* Structure for URID (URI to integer ID) mapping.
    LV2 uses URIs to identify different types of data.
    These are mapped to integers for efficiency during runtime */
 typedef struct {
     LV2_URID midi_Event;  // Integer ID for MIDI event type URI
+    LV2_URID atom_Int;    // Option value types
+    LV2_URID atom_Float;
+    LV2_URID atom_Vector; // State value type
+    LV2_URID polyphony;   // Option keys (plugin_uris.h)
+    LV2_URID cpu_cores;
+    LV2_URID dsp_budget;
+    LV2_URID program;     // State keys (plugin_uris.h)
+    LV2_URID controls;
+    LV2_URID channels;
 } URIDs;
 
+/* Preset held selected on a channel of the owning synth (LAZY_SAMPLES) */
+typedef struct {
+    int bank;          // Bank of the preset
+    int prog;          // Program of the preset
+    int users;         // Pins taken on the channel; free when 0
+} PresetPin;
+
+/* Process-wide SoundFont cache entry.
+   All plugin instances that load the same SoundFont file share a single
+   fluid_sfont_t, and therefore a single copy of its sample data. The sfont
+   is loaded and owned by a private FluidSynth instance that is never used
+   for rendering; plugin instances attach it with fluid_synth_add_sfont()
+   and detach it with fluid_synth_remove_sfont() before they are deleted.
+   The shared samples carry bookkeeping that every synth playing them updates
+   (FluidSynth counts the voices using a sample, and with lazy loading the
+   presets selected), so instances sharing a SoundFont take turns: anything
+   that plays, selects or releases its samples holds sample_lock */
+typedef struct SoundFontCacheEntry {
+    char* path;                       // Canonical SoundFont path (cache key)
+    fluid_settings_t* settings;       // Settings of the owning synth
+    fluid_synth_t* owner;             // Synth that loaded and owns the SoundFont
+    fluid_sfont_t* sfont;             // The shared SoundFont
+    int owner_sfont_id;               // ID of the SoundFont within the owning synth
+    pthread_mutex_t sample_lock;      // Serializes use of the samples across synths
+#if LAZY_SAMPLES
+    PresetPin pins[PRELOAD_CHANNELS]; // Preloaded presets, one per owner channel
+#endif
+    int refcount;                     // Number of plugin instances using it
+    bool retain;                      // Keep loaded without users (decoded SF3 samples)
+    unsigned long last_used;          // sfont_cache_clock when the last user released it
+    struct SoundFontCacheEntry* next; // Next entry in the cache list
+} SoundFontCacheEntry;
+
+// Cache of loaded SoundFonts, guarded by sfont_cache_lock.
+// Only accessed from instantiate() and cleanup(), never from run()
+static SoundFontCacheEntry* sfont_cache = NULL;
+static pthread_mutex_t sfont_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+static unsigned long sfont_cache_clock = 0; // Orders the releases of retained entries
+
+#if LAZY_SAMPLES
+/* Read cursor over a memory-mapped SoundFont file.
+   FluidSynth opens the file once to parse the preset data and again each
+   time it loads the samples of a newly selected preset */
+typedef struct {
+    const uint8_t* data;  // Start of the mapping
+    size_t size;          // Size of the file in bytes
+    size_t pos;           // Current read position
+} MappedFile;
+
+/*
+ * FluidSynth file callbacks backed by mmap.
+ * Only the pages that FluidSynth actually reads are faulted in, and they are
+ * served from the shared page cache rather than through a stdio buffer
+ */
+static void* mapped_open(const char* filename)
+{
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size <= 0) {
+        close(fd);
+        return NULL;
+    }
+
+    void* data = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // The mapping stays valid after the descriptor is closed
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    // Samples are read per preset, so read-ahead past them is wasted
+    madvise(data, (size_t)st.st_size, MADV_RANDOM);
+
+    MappedFile* file = (MappedFile*)calloc(1, sizeof(MappedFile));
+    if (!file) {
+        munmap(data, (size_t)st.st_size);
+        return NULL;
+    }
+    file->data = (const uint8_t*)data;
+    file->size = (size_t)st.st_size;
+    return file;
+}
+
+static int mapped_read(void* buf, fluid_long_long_t count, void* handle)
+{
+    MappedFile* file = (MappedFile*)handle;
+    if (count < 0 || (size_t)count > file->size - file->pos) {
+        return FLUID_FAILED;
+    }
+    memcpy(buf, file->data + file->pos, (size_t)count);
+    file->pos += (size_t)count;
+    return FLUID_OK;
+}
+
+static int mapped_seek(void* handle, fluid_long_long_t offset, int origin)
+{
+    MappedFile* file = (MappedFile*)handle;
+    fluid_long_long_t base;
+    switch (origin) {
+        case SEEK_SET: base = 0; break;
+        case SEEK_CUR: base = (fluid_long_long_t)file->pos; break;
+        case SEEK_END: base = (fluid_long_long_t)file->size; break;
+        default: return FLUID_FAILED;
+    }
+    if (base + offset < 0 || base + offset > (fluid_long_long_t)file->size) {
+        return FLUID_FAILED;
+    }
+    file->pos = (size_t)(base + offset);
+    return FLUID_OK;
+}
+
+static fluid_long_long_t mapped_tell(void* handle)
+{
+    return (fluid_long_long_t)((MappedFile*)handle)->pos;
+}
+
+static int mapped_close(void* handle)
+{
+    MappedFile* file = (MappedFile*)handle;
+    munmap((void*)file->data, file->size);
+    free(file);
+    return FLUID_OK;
+}
+#endif
+
+/*
+ * Check whether a SoundFont stores its samples compressed (SF3, ifil 3.x).
+ * Only the RIFF header and the ifil chunk at the start of the INFO list are read
+ */
+static bool sfont_is_compressed(const char* path)
+{
+    FILE* file = fopen(path, "rb");
+    if (!file) {
+        return false;
+    }
+    uint8_t header[36];
+    bool compressed = fread(header, 1, sizeof(header), file) == sizeof(header) &&
+                      !memcmp(header, "RIFF", 4) && !memcmp(header + 8, "sfbk", 4) &&
+                      !memcmp(header + 12, "LIST", 4) && !memcmp(header + 20, "INFO", 4) &&
+                      !memcmp(header + 24, "ifil", 4) &&
+                      preset_index_get_u16(header + 32) == 3;
+    fclose(file);
+    return compressed;
+}
+
+/*
+ * Get a shared SoundFont, loading it on first use.
+ * Returns: The cache entry with its refcount incremented, or NULL on failure
+ */
+static SoundFontCacheEntry* sfont_cache_acquire(const char* path, bool debug)
+{
+    // Canonicalize so that different spellings of the bundle path share an entry
+    char key[PATH_MAX];
+    if (!realpath(path, key)) {
+        strncpy(key, path, sizeof(key) - 1);
+        key[sizeof(key) - 1] = '\0';
+    }
+
+    pthread_mutex_lock(&sfont_cache_lock);
+
+    SoundFontCacheEntry* entry;
+    for (entry = sfont_cache; entry; entry = entry->next) {
+        if (strcmp(entry->path, key) == 0) {
+            entry->refcount++;
+            if (debug) {
+                fprintf(stderr, "Reusing cached SoundFont %s (%d users)\n", key, entry->refcount);
+            }
+            pthread_mutex_unlock(&sfont_cache_lock);
+            return entry;
+        }
+    }
+
+    entry = (SoundFontCacheEntry*)calloc(1, sizeof(SoundFontCacheEntry));
+    if (!entry) {
+        pthread_mutex_unlock(&sfont_cache_lock);
+        return NULL;
+    }
+
+    // The owning synth never renders, so keep it as small as possible
+    entry->settings = new_fluid_settings();
+    if (entry->settings) {
+        fluid_settings_setint(entry->settings, "synth.polyphony", 1);
+        fluid_settings_setint(entry->settings, "synth.reverb.active", 0);
+        fluid_settings_setint(entry->settings, "synth.chorus.active", 0);
+#if LAZY_SAMPLES
+        fluid_settings_setint(entry->settings, "synth.dynamic-sample-loading", 1);
+        fluid_settings_setint(entry->settings, "synth.midi-channels", PRELOAD_CHANNELS);
+#endif
+        entry->owner = new_fluid_synth(entry->settings);
+    }
+#if LAZY_SAMPLES
+    if (entry->owner) {
+        // Loaders are tried most recently added first, so this one takes precedence
+        fluid_sfloader_t* loader = new_fluid_defsfloader(entry->settings);
+        if (loader) {
+            fluid_sfloader_set_callbacks(loader, mapped_open, mapped_read,
+                                         mapped_seek, mapped_tell, mapped_close);
+            fluid_synth_add_sfloader(entry->owner, loader);
+        }
+    }
+#endif
+    if (entry->owner) {
+        entry->owner_sfont_id = fluid_synth_sfload(entry->owner, key, 0);
+        if (entry->owner_sfont_id != FLUID_FAILED) {
+            entry->sfont = fluid_synth_get_sfont_by_id(entry->owner, entry->owner_sfont_id);
+        }
+    }
+    entry->path = strdup(key);
+
+    if (!entry->sfont || !entry->path) {
+        fprintf(stderr, "Failed to load SoundFont: %s\n", key);
+        if (entry->owner) delete_fluid_synth(entry->owner);
+        if (entry->settings) delete_fluid_settings(entry->settings);
+        free(entry->path);
+        free(entry);
+        pthread_mutex_unlock(&sfont_cache_lock);
+        return NULL;
+    }
+
+    // FluidSynth decodes compressed samples while loading, which is far more
+    // expensive than reading PCM. Keep them decoded when the last instance
+    // goes away, so instantiating the plugin again does not decode again
+    entry->retain = RETAINED_SFONTS > 0 && sfont_is_compressed(key);
+
+    if (debug) {
+        fprintf(stderr, "Loaded SoundFont %s into shared cache%s\n", key,
+                entry->retain ? " (compressed, kept decoded)" : "");
+    }
+
+    pthread_mutex_init(&entry->sample_lock, NULL);
+    entry->refcount = 1;
+    entry->next = sfont_cache;
+    sfont_cache = entry;
+
+    pthread_mutex_unlock(&sfont_cache_lock);
+    return entry;
+}
+
+/* Free a cache entry that has been unlinked from the cache list */
+static void sfont_cache_free(SoundFontCacheEntry* entry)
+{
+    // Deleting the owning synth also deletes the SoundFont
+    delete_fluid_synth(entry->owner);
+    delete_fluid_settings(entry->settings);
+    pthread_mutex_destroy(&entry->sample_lock);
+    free(entry->path);
+    free(entry);
+}
+
+/*
+ * Unlink the least recently released retained entries without users until at
+ * most RETAINED_SFONTS of them remain. Called with sfont_cache_lock held.
+ * Returns: The unlinked entries, chained through next, for sfont_cache_free()
+ */
+static SoundFontCacheEntry* sfont_cache_evict(void)
+{
+    int idle = 0;
+    for (SoundFontCacheEntry* entry = sfont_cache; entry; entry = entry->next) {
+        if (entry->retain && entry->refcount == 0) idle++;
+    }
+
+    SoundFontCacheEntry* evicted = NULL;
+    for (; idle > RETAINED_SFONTS; idle--) {
+        SoundFontCacheEntry** oldest = NULL;
+        for (SoundFontCacheEntry** link = &sfont_cache; *link; link = &(*link)->next) {
+            if ((*link)->retain && (*link)->refcount == 0 &&
+                (!oldest || (*link)->last_used < (*oldest)->last_used)) {
+                oldest = link;
+            }
+        }
+        SoundFontCacheEntry* entry = *oldest;
+        *oldest = entry->next;
+        entry->next = evicted;
+        evicted = entry;
+    }
+    return evicted;
+}
+
+/*
+ * Drop a reference to a shared SoundFont.
+ * The SoundFont and its samples are freed when the last user releases it,
+ * unless the entry is retained (see sfont_cache_shutdown()); retained entries
+ * without users beyond RETAINED_SFONTS are freed oldest first.
+ * Callers must have removed the sfont from their own synth beforehand
+ */
+static void sfont_cache_release(SoundFontCacheEntry* entry)
+{
+    pthread_mutex_lock(&sfont_cache_lock);
+
+    if (--entry->refcount > 0) {
+        pthread_mutex_unlock(&sfont_cache_lock);
+        return;
+    }
+
+    if (entry->retain) {
+        entry->last_used = ++sfont_cache_clock;
+        SoundFontCacheEntry* evicted = sfont_cache_evict();
+        pthread_mutex_unlock(&sfont_cache_lock);
+        while (evicted) {
+            SoundFontCacheEntry* next = evicted->next;
+            sfont_cache_free(evicted);
+            evicted = next;
+        }
+        return;
+    }
+
+    // Unlink from the cache list
+    SoundFontCacheEntry** link = &sfont_cache;
+    while (*link && *link != entry) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = entry->next;
+    }
+
+    pthread_mutex_unlock(&sfont_cache_lock);
+
+    sfont_cache_free(entry);
+}
+
+/*
+ * Free the retained SoundFonts that no instance uses when the plugin library
+ * is unloaded
+ */
+__attribute__((destructor))
+static void sfont_cache_shutdown(void)
+{
+    pthread_mutex_lock(&sfont_cache_lock);
+
+    SoundFontCacheEntry** link = &sfont_cache;
+    while (*link) {
+        SoundFontCacheEntry* entry = *link;
+        if (entry->refcount == 0) {
+            *link = entry->next;
+            sfont_cache_free(entry);
+        } else {
+            link = &entry->next;
+        }
+    }
+
+    pthread_mutex_unlock(&sfont_cache_lock);
+}
+
+/*
+ * Make sure the samples of a preset are loaded before an instance selects it,
+ * and keep them loaded until sfont_cache_unpin().
+ * With lazy sample loading, selecting the preset on a channel of the
+ * otherwise idle owner synth reads its samples on the calling (non-realtime)
+ * thread. Every pinned preset has a channel of its own, counting its pins, so
+ * a preload for another instance cannot unload the samples before the program
+ * change on this instance's synth is applied. If every channel is taken,
+ * nothing is pinned and the samples load when the instance selects the preset.
+ * Without lazy loading all samples are already resident and this is a no-op
+ * Returns: The pin for sfont_cache_unpin(), or -1 if nothing was pinned
+ */
+static int sfont_cache_pin(SoundFontCacheEntry* entry, int bank, int prog)
+{
+#if LAZY_SAMPLES
+    int pin = -1, free_chan = -1;
+    pthread_mutex_lock(&entry->sample_lock);
+    for (int chan = 0; chan < PRELOAD_CHANNELS; chan++) {
+        const PresetPin* p = &entry->pins[chan];
+        if (p->users == 0) {
+            if (free_chan < 0) free_chan = chan;
+        } else if (p->bank == bank && p->prog == prog) {
+            pin = chan;
+            break;
+        }
+    }
+    if (pin < 0 && free_chan >= 0 &&
+        fluid_synth_program_select(entry->owner, free_chan, entry->owner_sfont_id,
+                                   bank, prog) == FLUID_OK) {
+        pin = free_chan;
+        entry->pins[pin].bank = bank;
+        entry->pins[pin].prog = prog;
+    }
+    if (pin >= 0) {
+        entry->pins[pin].users++;
+    }
+    pthread_mutex_unlock(&entry->sample_lock);
+    return pin;
+#else
+    (void)entry;
+    (void)bank;
+    (void)prog;
+    return -1;
+#endif
+}
+
+/*
+ * Drop a pin taken by sfont_cache_pin(). With the last pin of a preset its
+ * samples are unloaded, unless an instance synth has the preset selected
+ */
+static void sfont_cache_unpin(SoundFontCacheEntry* entry, int pin)
+{
+#if LAZY_SAMPLES
+    if (pin < 0) {
+        return;
+    }
+    pthread_mutex_lock(&entry->sample_lock);
+    if (--entry->pins[pin].users == 0) {
+        fluid_synth_unset_program(entry->owner, pin);
+    }
+    pthread_mutex_unlock(&entry->sample_lock);
+#else
+    (void)entry;
+    (void)pin;
+#endif
+}
+
+/*
+ * Ask the kernel to start reading a preset's sample data in the background.
+ * The byte ranges come from the preset index, so this is a no-op for presets
+ * without index information or when lazy sample loading is disabled
+ */
+static void sfont_cache_prefetch(SoundFontCacheEntry* entry, const PresetRange* ranges, uint32_t count)
+{
+#if LAZY_SAMPLES
+    if (count == 0) {
+        return;
+    }
+    int fd = open(entry->path, O_RDONLY);
+    if (fd < 0) {
+        return;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        posix_fadvise(fd, (off_t)ranges[i].offset, (off_t)ranges[i].length, POSIX_FADV_WILLNEED);
+    }
+    close(fd);
+#else
+    (void)entry;
+    (void)ranges;
+    (void)count;
+#endif
+}
+
+/* Types of work handed to the LV2 worker thread */
+typedef enum {
+    WORK_PROGRAM_CHANGE = 1,  // Preload samples and switch to a program
+    WORK_CHANNEL_PROGRAM = 2  // Preload samples and apply a MIDI program change
+} WorkType;
+
+/* Message passed from run() to the worker and back to work_response() */
+typedef struct {
+    uint32_t type;     // One of WorkType
+    int32_t program;   // Program index for WORK_PROGRAM_CHANGE,
+                       // MIDI program number for WORK_CHANNEL_PROGRAM
+    int32_t channel;   // MIDI channel for WORK_CHANNEL_PROGRAM
+    int32_t bank;      // Bank selected on the channel for WORK_CHANNEL_PROGRAM
+    bool dropped;      // Set in the response when the command ring was full
+    int32_t pin;       // Set by the worker: preset pin held until the next
+                       // command for the channel is applied (see sfont_cache_pin())
+} WorkMessage;
+
+/* Work messages posted to run() by the worker. One thread writes, the
+   audio thread reads: the writer only moves head, the reader only tail */
+typedef struct {
+    WorkMessage commands[COMMAND_RING_SIZE];
+    atomic_uint head;  // Next slot to write
+    atomic_uint tail;  // Next slot to read
+    unsigned released; // Next read slot whose pin the writer still holds
+    int32_t held[MIDI_CHANNELS]; // Pin of the command last read for each channel
+} CommandRing;
+
+/*
+ * Move on the pins of the commands before slot end, which the reader has
+ * applied or cleared. The last command read for a channel keeps its pin
+ * until the next one for the channel is read: applying that one unselects
+ * the preset on the instance synth, and the pin keeps the samples from
+ * being unloaded there, on the audio thread. Only the writer may call this,
+ * since the unpinning can unload samples
+ */
+static void command_ring_unpin(CommandRing* ring, SoundFontCacheEntry* entry, unsigned end)
+{
+    for (; ring->released != end; ring->released++) {
+        const WorkMessage* cmd = &ring->commands[ring->released % COMMAND_RING_SIZE];
+        int chan = (cmd->type == WORK_CHANNEL_PROGRAM) ? cmd->channel : 0;
+        if (chan < 0 || chan >= MIDI_CHANNELS) {
+            sfont_cache_unpin(entry, cmd->pin);
+            continue;
+        }
+        sfont_cache_unpin(entry, ring->held[chan]);
+        ring->held[chan] = cmd->pin;
+    }
+}
+
+/* Drop every pin the ring holds; the writer must have stopped */
+static void command_ring_unpin_all(CommandRing* ring, SoundFontCacheEntry* entry)
+{
+    command_ring_unpin(ring, entry, atomic_load_explicit(&ring->head, memory_order_acquire));
+    for (int chan = 0; chan < MIDI_CHANNELS; chan++) {
+        sfont_cache_unpin(entry, ring->held[chan]);
+        ring->held[chan] = -1;
+    }
+}
+
+/*
+ * Queue a command for the reader, first releasing the pins the commands it
+ * has read no longer need.
+ * Returns: false if the ring is full
+ */
+static bool command_ring_push(CommandRing* ring, const WorkMessage* cmd, SoundFontCacheEntry* entry)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    command_ring_unpin(ring, entry, tail);
+    if (head - tail == COMMAND_RING_SIZE) {
+        return false;
+    }
+    ring->commands[head % COMMAND_RING_SIZE] = *cmd;
+    atomic_store_explicit(&ring->head, head + 1, memory_order_release);
+    return true;
+}
+
+/*
+ * Oldest queued command; it stays queued until command_ring_pop().
+ * Returns: NULL if the ring is empty
+ */
+static const WorkMessage* command_ring_peek(CommandRing* ring)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    return (tail == head) ? NULL : &ring->commands[tail % COMMAND_RING_SIZE];
+}
+
+static void command_ring_pop(CommandRing* ring)
+{
+    unsigned tail = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+    atomic_store_explicit(&ring->tail, tail + 1, memory_order_release);
+}
+
+/* Drop every queued command; only the reader may call this */
+static void command_ring_clear(CommandRing* ring)
+{
+    unsigned head = atomic_load_explicit(&ring->head, memory_order_acquire);
+    atomic_store_explicit(&ring->tail, head, memory_order_release);
+}
+
+/* Latest MIDI program change on a channel (MULTITIMBRAL) */
+typedef struct {
+    int bank;          // Bank selected on the channel when the change arrived
+    int prog;          // MIDI program number
+    bool deferred;     // Not handed on yet; run() retries it every cycle
+} ChannelProgram;
+
+/* LV2 descriptor together with the plugin name it was created for.
+   Every descriptor handed to the host is one of these, so instantiate()
+   can recover the name */
+typedef struct {
+    LV2_Descriptor lv2;   // Must be first: the host only sees this part
+    const char* name;     // Plugin name, for logging
+} PluginDescriptor;
+
 /* Main plugin instance structure.
    Contains all state and data needed for plugin operation */
 typedef struct {
     // LV2 host features
     LV2_URID_Map* map;    // Host-provided URID mapping feature
+    LV2_Worker_Schedule* schedule; // Host-provided worker (optional)
     URIDs urids;          // Our mapped URIDs for event handling
 
     // Port connections - pointers to host-provided buffers
@@ -110,6 +870,12 @@ typedef struct {
     float* decay_port;     // Control value for envelope decay
     float* sustain_port;   // Control value for envelope sustain
     float* release_port;   // Control value for envelope release
+#if CHANNEL_OUTPUTS
+    float* channel_out[2 * MIDI_CHANNELS]; // Per-channel outputs, left/right interleaved
+#endif
+#if PERF_PORTS
+    float* perf_ports[PERF_PORT_COUNT];    // Performance counter outputs
+#endif
 
     // Debug flag for logging
     bool debug;           // When true, outputs debug information to stderr
@@ -118,16 +884,37 @@ typedef struct {
     fluid_settings_t* settings;  // FluidSynth configuration settings
     fluid_synth_t* synth;       // FluidSynth synthesizer instance
     int current_program;        // Currently selected program number
+    int requested_program;      // Last program handed to the worker
+    bool program_pending;       // A program change is on the worker or queued for run()
+    CommandRing commands;       // Program changes the worker leaves to run()
+#if MULTITIMBRAL
+    ChannelProgram channel_programs[MIDI_CHANNELS]; // Latest program change per channel
+#endif
     BankProgram* programs;      // Array of available program bank/number pairs
-    int sfont_id;              // ID of loaded SoundFont
+    PresetRange* ranges;        // Sample byte ranges referenced by programs
+    SoundFontCacheEntry* sfont_entry; // Shared SoundFont used by this instance
+    int sfont_id;              // ID of the SoundFont within this synth
     int program_count;         // Total number of available programs
 
-    // Audio processing buffers
+    // Plugin resources
     char* bundle_path;     // Path to plugin's resource directory
-    float* buffer_l;       // Temporary buffer for left channel processing
-    float* buffer_r;       // Temporary buffer for right channel processing
     double rate;          // Audio sample rate in Hz
 
+    // Voice governor
+    int max_polyphony;     // Voices allocated at instantiate
+    int voice_limit;       // Polyphony currently set on the synth
+    float dsp_budget;      // Target cost of run() in percent of the period (0 = off)
+    float load_avg;        // Smoothed cost of run() in percent of the period
+    uint32_t calm_frames;  // Frames rendered since the load was last high
+
+    // Performance counters (PERF_PORTS)
+    uint32_t voice_steals; // Note-ons that found every voice busy
+    float peak_load;       // Highest cycle load since activation
+
+    // Idle detection (IDLE_SKIP)
+    uint32_t silent_frames; // Frames rendered since the last voice ended
+    bool idle;              // Nothing sounding; run() may skip the synth
+
     // Parameter change tracking
     float prev_cutoff;     // Previous value of cutoff control
     float prev_resonance;  // Previous value of resonance control
@@ -137,12 +924,166 @@ typedef struct {
     float prev_release;    // Previous value of release control
 } Plugin;
 
+/* Order programs by bank, then program number */
+static int compare_programs(const void* a, const void* b) {
+    const BankProgram* pa = (const BankProgram*)a;
+    const BankProgram* pb = (const BankProgram*)b;
+    if (pa->bank != pb->bank) {
+        return pa->bank - pb->bank;
+    }
+    return pa->prog - pb->prog;
+}
+
+/*
+ * Build the program table from the preset index written by the metadata
+ * generator (see preset_index.h). Every entry is checked against the loaded
+ * SoundFont so a stale index is rejected rather than trusted.
+ * Returns: 0 on success, -1 if the index is missing or does not match
+ */
+static int load_preset_index(Plugin* plugin, const char* bundle_path, fluid_sfont_t* sfont) {
+    char index_path[4096];
+    snprintf(index_path, sizeof(index_path), "%s/%s", bundle_path, PRESET_INDEX_FILE);
+
+    FILE* file = fopen(index_path, "rb");
+    if (!file) {
+        if (plugin->debug) {
+            fprintf(stderr, "No preset index at %s, scanning presets\n", index_path);
+        }
+        return -1;
+    }
+
+    uint8_t header[PRESET_INDEX_HEADER_SIZE];
+    uint8_t* records = NULL;
+    uint8_t* range_data = NULL;
+    BankProgram* programs = NULL;
+    PresetRange* ranges = NULL;
+    uint32_t count = 0, range_count = 0;
+    int result = -1;
+
+    if (fread(header, 1, sizeof(header), file) != sizeof(header) ||
+        memcmp(header, PRESET_INDEX_MAGIC, 4) != 0 ||
+        preset_index_get_u32(header + 4) != PRESET_INDEX_VERSION) {
+        goto done;
+    }
+    count = preset_index_get_u32(header + 8);
+    range_count = preset_index_get_u32(header + 12);
+    if (count == 0 || count > 129 * 128 || range_count > (1u << 24)) {
+        goto done;
+    }
+
+    records = (uint8_t*)malloc((size_t)count * PRESET_INDEX_PRESET_SIZE);
+    range_data = (uint8_t*)malloc((size_t)range_count * PRESET_INDEX_RANGE_SIZE + 1);
+    programs = (BankProgram*)calloc(count, sizeof(BankProgram));
+    ranges = (PresetRange*)calloc(range_count + 1, sizeof(PresetRange));
+    if (!records || !range_data || !programs || !ranges ||
+        fread(records, PRESET_INDEX_PRESET_SIZE, count, file) != count ||
+        fread(range_data, PRESET_INDEX_RANGE_SIZE, range_count, file) != range_count) {
+        goto done;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t* rec = records + (size_t)i * PRESET_INDEX_PRESET_SIZE;
+        programs[i].bank = preset_index_get_u16(rec);
+        programs[i].prog = preset_index_get_u16(rec + 2);
+        programs[i].first_range = preset_index_get_u32(rec + 4);
+        programs[i].range_count = preset_index_get_u32(rec + 8);
+        if (programs[i].first_range > range_count ||
+            programs[i].range_count > range_count - programs[i].first_range ||
+            fluid_sfont_get_preset(sfont, programs[i].bank, programs[i].prog) == NULL) {
+            if (plugin->debug) {
+                fprintf(stderr, "Preset index does not match SoundFont, scanning presets\n");
+            }
+            goto done;
+        }
+    }
+    for (uint32_t i = 0; i < range_count; i++) {
+        ranges[i].offset = preset_index_get_u64(range_data + (size_t)i * PRESET_INDEX_RANGE_SIZE);
+        ranges[i].length = preset_index_get_u64(range_data + (size_t)i * PRESET_INDEX_RANGE_SIZE + 8);
+    }
+
+    plugin->programs = programs;
+    plugin->program_count = (int)count;
+    plugin->ranges = ranges;
+    programs = NULL;
+    ranges = NULL;
+    result = 0;
+
+done:
+    fclose(file);
+    free(records);
+    free(range_data);
+    free(programs);
+    free(ranges);
+    return result;
+}
+
+/*
+ * Build the program table by walking the SoundFont's presets.
+ * Used when no preset index is available; sample ranges are left empty.
+ * Returns: 0 on success, -1 on failure
+ */
+static int scan_presets(Plugin* plugin, fluid_sfont_t* sfont) {
+    int count = 0, capacity = 0;
+    BankProgram* programs = NULL;
+    fluid_preset_t* preset;
+
+    fluid_sfont_iteration_start(sfont);
+    while ((preset = fluid_sfont_iteration_next(sfont)) != NULL) {
+        int bank = fluid_preset_get_banknum(preset);
+        if (bank < 0 || bank > 128) {          // Bank 128 is percussion
+            continue;
+        }
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 128;
+            BankProgram* grown = (BankProgram*)realloc(programs, capacity * sizeof(BankProgram));
+            if (!grown) {
+                free(programs);
+                return -1;
+            }
+            programs = grown;
+        }
+        programs[count].bank = bank;
+        programs[count].prog = fluid_preset_get_num(preset);
+        programs[count].first_range = 0;
+        programs[count].range_count = 0;
+        count++;
+    }
+
+    if (count == 0) {
+        free(programs);
+        return -1;
+    }
+
+    // Program port order is by bank, then program, matching the generated TTL
+    qsort(programs, count, sizeof(BankProgram), compare_programs);
+    plugin->programs = programs;
+    plugin->program_count = count;
+    return 0;
+}
+
+/*
+ * Take the lock that serializes use of the shared samples (see
+ * SoundFontCacheEntry). run() holds it for the whole cycle; everything else
+ * that plays, selects or releases presets on this instance's synth takes it
+ * too, so two synths never update the samples' bookkeeping at once
+ */
+static void lock_samples(Plugin* plugin)
+{
+    pthread_mutex_lock(&plugin->sfont_entry->sample_lock);
+}
+
+static void unlock_samples(Plugin* plugin)
+{
+    pthread_mutex_unlock(&plugin->sfont_entry->sample_lock);
+}
+
 /*
  * Load and initialize the SoundFont file.
  * This function:
- * 1. Loads the specified SoundFont file
- * 2. Scans it for available presets
- * 3. Stores preset information for program changes
+ * 1. Gets the SoundFont from the shared cache (loading it if needed)
+ * 2. Attaches it to this instance's synth
+ * 3. Reads the preset index (or scans the SoundFont if there is none)
+ * 4. Stores preset information for program changes
  * Returns: The SoundFont ID if successful, -1 on failure
  */
 static int load_soundfont(Plugin* plugin) {
@@ -174,138 +1115,448 @@ static int load_soundfont(Plugin* plugin) {
         fprintf(stderr, "Working directory: %s\n", getcwd(NULL, 0));
     }
     
-    // Use the properly constructed path
-    plugin->sfont_id = fluid_synth_sfload(plugin->synth, sf_path, 1);
+    // Use the properly constructed path to get the shared SoundFont
+    plugin->sfont_entry = sfont_cache_acquire(sf_path, plugin->debug);
+    if (!plugin->sfont_entry) {
+        return -1;
+    }
+
+    // Attach it to this instance's synth; samples are not copied. Attaching
+    // selects a preset on every channel, so it holds the sample lock like any
+    // selection
+    fluid_sfont_t* sfont = plugin->sfont_entry->sfont;
+    lock_samples(plugin);
+    plugin->sfont_id = fluid_synth_add_sfont(plugin->synth, sfont);
+    unlock_samples(plugin);
     if (plugin->sfont_id == FLUID_FAILED) {
-        fprintf(stderr, "Failed to load SoundFont: %s\n", sf_path);
+        fprintf(stderr, "Failed to attach SoundFont: %s\n", sf_path);
+        sfont_cache_release(plugin->sfont_entry);
+        plugin->sfont_entry = NULL;
         return -1;
     }
 
-    // Get a handle to the loaded SoundFont for preset scanning
-    fluid_sfont_t* sfont = fluid_synth_get_sfont(plugin->synth, 0);
-    if (!sfont) {
-        fprintf(stderr, "Failed to get soundfont instance\n");
+    // Build the program table from the bundled preset index, falling back
+    // to walking the SoundFont's preset list if the index is missing or stale
+    if (load_preset_index(plugin, normalized_bundle_path, sfont) != 0 &&
+        scan_presets(plugin, sfont) != 0) {
+        fprintf(stderr, "Failed to build program table\n");
+        lock_samples(plugin);
+        fluid_synth_remove_sfont(plugin->synth, sfont);
+        unlock_samples(plugin);
+        sfont_cache_release(plugin->sfont_entry);
+        plugin->sfont_entry = NULL;
         return -1;
     }
 
-    // First pass: Count total available presets across all banks
-    size_t preset_count = 0;
-    for (int bank = 0; bank <= 128; bank++) {          // Bank 128 is percussion
-        for (int prog = 0; prog < 128; prog++) {       // Programs 0-127 in each bank
-            if (fluid_sfont_get_preset(sfont, bank, prog) != NULL) {
-                preset_count++;                         // Count each valid preset
-            }
+    if (plugin->debug) {
+        fprintf(stderr, "Found %d total presets in soundfont\n", plugin->program_count);
+        for (int idx = 0; idx < plugin->program_count; idx++) {
+            int bank = plugin->programs[idx].bank;
+            int prog = plugin->programs[idx].prog;
+            fprintf(stderr, "Stored program %d: bank=%d prog=%d name=%s\n",
+                    idx, bank, prog, fluid_preset_get_name(fluid_sfont_get_preset(sfont, bank, prog)));
+        }
+    }
+
+    return plugin->sfont_id;  // Return the SoundFont ID for success
+}
+
+/*
+ * Map URIs for MIDI event handling
+ */
+static void map_uris(LV2_URID_Map* map, URIDs* uris) {
+    uris->midi_Event = map->map(map->handle, LV2_MIDI__MidiEvent);
+    uris->atom_Int = map->map(map->handle, LV2_ATOM__Int);
+    uris->atom_Float = map->map(map->handle, LV2_ATOM__Float);
+    uris->atom_Vector = map->map(map->handle, LV2_ATOM__Vector);
+    uris->polyphony = map->map(map->handle, SF2LV2__polyphony);
+    uris->cpu_cores = map->map(map->handle, SF2LV2__cpuCores);
+    uris->dsp_budget = map->map(map->handle, SF2LV2__dspBudget);
+    uris->program = map->map(map->handle, SF2LV2__program);
+    uris->controls = map->map(map->handle, SF2LV2__controls);
+    uris->channels = map->map(map->handle, SF2LV2__channels);
+}
+
+/*
+ * Read a numeric option value (atom:Int or atom:Float).
+ * Returns: true if the option has a usable value
+ */
+static bool option_value(const URIDs* uris, const LV2_Options_Option* opt, double* value) {
+    if (opt->type == uris->atom_Int && opt->size == sizeof(int32_t)) {
+        *value = *(const int32_t*)opt->value;
+        return true;
+    }
+    if (opt->type == uris->atom_Float && opt->size == sizeof(float)) {
+        *value = *(const float*)opt->value;
+        return true;
+    }
+    return false;
+}
+
+/*
+ * Apply instantiation options from the host, keeping the build-time
+ * defaults for anything missing or out of range
+ */
+static void read_options(Plugin* plugin, const LV2_Options_Option* options,
+                         int* polyphony, int* cpu_cores) {
+    for (const LV2_Options_Option* opt = options; opt && opt->key; opt++) {
+        double value;
+        if (opt->context != LV2_OPTIONS_INSTANCE || !option_value(&plugin->urids, opt, &value)) {
+            continue;
+        }
+        if (opt->key == plugin->urids.polyphony && value >= 1 && value <= 65535) {
+            *polyphony = (int)value;
+        } else if (opt->key == plugin->urids.cpu_cores && value >= 1 && value <= 256) {
+            *cpu_cores = (int)value;
+        } else if (opt->key == plugin->urids.dsp_budget && value >= 0 && value <= 100) {
+            plugin->dsp_budget = (float)value;
         }
     }
 
     if (plugin->debug) {
-        fprintf(stderr, "Found %zu total presets in soundfont\n", preset_count);
+        fprintf(stderr, "Polyphony: %d, CPU cores: %d, DSP budget: %.0f%%\n",
+                *polyphony, *cpu_cores, plugin->dsp_budget);
     }
-    plugin->program_count = preset_count;
+}
 
-    // Allocate memory to store information about each preset
-    plugin->programs = (BankProgram*)calloc(preset_count, sizeof(BankProgram));
-    if (!plugin->programs) {
-        fprintf(stderr, "Failed to allocate program array\n");
-        return -1;
+/*
+ * Handle program changes with proper bank selection.
+ * The caller holds the sample lock (lock_samples)
+ */
+static void handle_program_change(Plugin* plugin, int program) {
+    if (program < 0 || program >= plugin->program_count) {
+        if (plugin->debug) {
+            fprintf(stderr, "Invalid program number: %d (max: %d)\n", 
+                    program, plugin->program_count - 1);
+        }
+        return;
+    }
+
+    // Reset all notes and sounds. In multi-timbral mode the program port
+    // only drives channel 1, so the other parts keep playing
+    fluid_synth_all_notes_off(plugin->synth, MULTITIMBRAL ? 0 : -1);
+    fluid_synth_all_sounds_off(plugin->synth, MULTITIMBRAL ? 0 : -1);
+
+    int bank = plugin->programs[program].bank;
+    int prog = plugin->programs[program].prog;
+
+    if (plugin->debug) {
+        fprintf(stderr, "Changing to program %d (bank:%d prog:%d)\n", 
+                program, bank, prog);
+    }
+
+    // Reset CCs (cutoff to max, others to 0)
+    fluid_synth_cc(plugin->synth, 0, CC_CUTOFF, 127);    // Cutoff fully open
+    fluid_synth_cc(plugin->synth, 0, CC_RESONANCE, 0);
+    fluid_synth_cc(plugin->synth, 0, CC_ATTACK, 0);
+    fluid_synth_cc(plugin->synth, 0, CC_DECAY, 0);
+    fluid_synth_cc(plugin->synth, 0, CC_SUSTAIN, 0);
+    fluid_synth_cc(plugin->synth, 0, CC_RELEASE, 0);
+
+    // Send bank select first
+    fluid_synth_bank_select(plugin->synth, 0, bank);
+    
+    // Then send program change
+    int result = fluid_synth_program_change(plugin->synth, 0, prog);
+    
+    if (result != FLUID_OK) {
+        if (plugin->debug) {
+            fprintf(stderr, "Failed to change program: bank=%d prog=%d\n", bank, prog);
+        }
+    }
+
+    if (plugin->debug) {
+        // Debug output showing FluidSynth CC values
+        int cc_value;
+        fprintf(stderr, "CC values after program change:\n");
+        
+        fluid_synth_get_cc(plugin->synth, 0, CC_CUTOFF, &cc_value);
+        fprintf(stderr, "  Cutoff (CC%d): %d\n", CC_CUTOFF, cc_value);
+        
+        fluid_synth_get_cc(plugin->synth, 0, CC_RESONANCE, &cc_value);
+        fprintf(stderr, "  Resonance (CC%d): %d\n", CC_RESONANCE, cc_value);
+        
+        fluid_synth_get_cc(plugin->synth, 0, CC_ATTACK, &cc_value);
+        fprintf(stderr, "  Attack (CC%d): %d\n", CC_ATTACK, cc_value);
+        
+        fluid_synth_get_cc(plugin->synth, 0, CC_DECAY, &cc_value);
+        fprintf(stderr, "  Decay (CC%d): %d\n", CC_DECAY, cc_value);
+        
+        fluid_synth_get_cc(plugin->synth, 0, CC_SUSTAIN, &cc_value);
+        fprintf(stderr, "  Sustain (CC%d): %d\n", CC_SUSTAIN, cc_value);
+        
+        fluid_synth_get_cc(plugin->synth, 0, CC_RELEASE, &cc_value);
+        fprintf(stderr, "  Release (CC%d): %d\n", CC_RELEASE, cc_value);
+    }
+}
+
+/*
+ * Select a program on a MIDI channel from the given bank.
+ * The caller holds the sample lock (lock_samples)
+ */
+static void apply_channel_program(Plugin* plugin, int chan, int bank, int prog)
+{
+    // Re-apply the bank captured with the program change, then let FluidSynth
+    // resolve the preset (including its drum channel and fallback rules)
+    fluid_synth_bank_select(plugin->synth, chan, bank);
+    int result = fluid_synth_program_change(plugin->synth, chan, prog);
+
+    if (result != FLUID_OK && plugin->debug) {
+        fprintf(stderr, "Failed to change program: channel=%d bank=%d prog=%d\n",
+                chan + 1, bank, prog);
+    }
+}
+
+#if MULTITIMBRAL
+/*
+ * Hand a channel's latest program change on, or leave it deferred. With lazy
+ * sample loading the change may load samples, so it goes to the worker when
+ * the host provides one, and a full worker queue leaves it for the next
+ * cycle; otherwise selecting a preset is cheap and is applied in place.
+ * The caller holds the sample lock (lock_samples)
+ */
+static void request_channel_program(Plugin* plugin, int chan)
+{
+    ChannelProgram* change = &plugin->channel_programs[chan];
+
+#if LAZY_SAMPLES
+    if (plugin->schedule) {
+        WorkMessage msg = { WORK_CHANNEL_PROGRAM, change->prog, chan, change->bank };
+        change->deferred = plugin->schedule->schedule_work(plugin->schedule->handle,
+                                                           sizeof(msg), &msg) != LV2_WORKER_SUCCESS;
+        return;
+    }
+#endif
+
+    change->deferred = false;
+    apply_channel_program(plugin, chan, change->bank, change->prog);
+}
+
+/*
+ * Handle a MIDI program change (0xC0). The bank is the one last selected on
+ * the channel with CC 0, which FluidSynth tracks as the CC passes through.
+ * The change replaces any change still deferred on the channel
+ */
+static void handle_channel_program(Plugin* plugin, int chan, int prog)
+{
+    int sfont_id, bank, old_prog;
+    if (fluid_synth_get_program(plugin->synth, chan, &sfont_id, &bank, &old_prog) != FLUID_OK) {
+        return;
+    }
+
+    plugin->channel_programs[chan] = (ChannelProgram){ bank, prog, false };
+    request_channel_program(plugin, chan);
+}
+
+/* Retry the channel program changes earlier cycles had to leave */
+static void run_deferred_programs(Plugin* plugin)
+{
+    for (int chan = 0; chan < MIDI_CHANNELS; chan++) {
+        if (plugin->channel_programs[chan].deferred) {
+            request_channel_program(plugin, chan);
+            plugin->idle = false;
+        }
+    }
+}
+#endif
+
+/*
+ * Make the program change a work message asks for, once its samples are
+ * loaded. The caller holds the sample lock (lock_samples)
+ */
+static void apply_command(Plugin* plugin, const WorkMessage* msg)
+{
+    switch (msg->type) {
+        case WORK_PROGRAM_CHANGE:
+            handle_program_change(plugin, msg->program);
+            break;
+#if MULTITIMBRAL
+        case WORK_CHANNEL_PROGRAM:
+            apply_channel_program(plugin, msg->channel, msg->bank, msg->program);
+            break;
+#endif
+    }
+}
+
+/*
+ * Apply the commands the worker posted for the synth.
+ * The caller holds the sample lock (lock_samples)
+ */
+static void run_commands(Plugin* plugin)
+{
+    const WorkMessage* msg;
+    while ((msg = command_ring_peek(&plugin->commands))) {
+        apply_command(plugin, msg);
+        // The program port takes effect here, whether or not the host
+        // delivers the worker's response. Requests overtaken by a state
+        // restore (no longer pending) are ignored
+        if (msg->type == WORK_PROGRAM_CHANGE && plugin->program_pending) {
+            plugin->current_program = msg->program;
+            // Later requests may still be queued behind this one
+            plugin->program_pending = (msg->program != plugin->requested_program);
+        }
+        command_ring_pop(&plugin->commands);
+        plugin->idle = false;
     }
+}
 
-    // Second pass: Store bank/program numbers for each preset
-    int idx = 0;
-    for (int bank = 0; bank <= 128; bank++) {
-        for (int prog = 0; prog < 128; prog++) {
-            fluid_preset_t* preset = fluid_sfont_get_preset(sfont, bank, prog);
-            if (preset != NULL) {
-                // Store the bank and program numbers for this preset
-                plugin->programs[idx].bank = bank;
-                plugin->programs[idx].prog = prog;
-                if (plugin->debug) {
-                    fprintf(stderr, "Stored program %d: bank=%d prog=%d name=%s\n",
-                            idx, bank, prog, fluid_preset_get_name(preset));
+/*
+ * Dispatch a single MIDI message to FluidSynth.
+ * Messages are played on channel 1 unless MULTITIMBRAL keeps their channel
+ */
+static void handle_midi_event(Plugin* plugin, const uint8_t* msg)
+{
+    int chan = MIDI_CHANNEL(msg);
+
+    switch (msg[0] & 0xF0) {
+        case 0x90:  // Note On (velocity > 0) or Note Off (velocity = 0)
+            if (msg[2] > 0) {
+#if PERF_PORTS
+                // FluidSynth steals a voice when all of them are busy
+                if (fluid_synth_get_active_voice_count(plugin->synth) >= plugin->voice_limit) {
+                    plugin->voice_steals++;
                 }
-                idx++;
+#endif
+                fluid_synth_noteon(plugin->synth, chan, msg[1], msg[2]);
+            } else {
+                fluid_synth_noteoff(plugin->synth, chan, msg[1]);
             }
-        }
+            break;
+        case 0x80:  // Note Off
+            fluid_synth_noteoff(plugin->synth, chan, msg[1]);
+            break;
+        case 0xB0:  // Control Change (including bank select)
+            fluid_synth_cc(plugin->synth, chan, msg[1], msg[2]);
+            break;
+#if MULTITIMBRAL
+        case 0xC0:  // Program Change
+            handle_channel_program(plugin, chan, msg[1]);
+            break;
+#endif
+        case 0xE0:  // Pitch Bend (14-bit value from two 7-bit values)
+            fluid_synth_pitch_bend(plugin->synth, chan,
+                (msg[2] << 7) | msg[1]);
+            break;
     }
-    
-    return plugin->sfont_id;  // Return the SoundFont ID for success
 }
 
 /*
- * Map URIs for MIDI event handling
+ * Render frames [offset, offset + frames) directly into the output ports.
+ * FluidSynth writes at the given offsets, so no intermediate buffer is needed
  */
-static void map_uris(LV2_URID_Map* map, URIDs* uris) {
-    uris->midi_Event = map->map(map->handle, LV2_MIDI__MidiEvent);
+static void render_audio(Plugin* plugin, uint32_t offset, uint32_t frames)
+{
+    while (frames > 0) {
+        uint32_t chunk_size = (BUFFER_SIZE > 0 && frames > BUFFER_SIZE) ? BUFFER_SIZE : frames;
+
+#if CHANNEL_OUTPUTS
+        // Each MIDI channel is its own audio group, rendered into its own
+        // pair of outputs. fluid_synth_process() mixes into the buffers, so
+        // they are cleared first
+        float* outs[2 * MIDI_CHANNELS];
+        for (int i = 0; i < 2 * MIDI_CHANNELS; i++) {
+            outs[i] = plugin->channel_out[i] + offset;
+            memset(outs[i], 0, chunk_size * sizeof(float));
+        }
+        fluid_synth_process(plugin->synth, chunk_size, 0, NULL, 2 * MIDI_CHANNELS, outs);
+
+        // The main outputs carry the mix of all channels
+        float* out_l = plugin->audio_out_l + offset;
+        float* out_r = plugin->audio_out_r + offset;
+        memcpy(out_l, outs[0], chunk_size * sizeof(float));
+        memcpy(out_r, outs[1], chunk_size * sizeof(float));
+        for (int ch = 1; ch < MIDI_CHANNELS; ch++) {
+            const float* ch_l = outs[2 * ch];
+            const float* ch_r = outs[2 * ch + 1];
+            for (uint32_t i = 0; i < chunk_size; i++) {
+                out_l[i] += ch_l[i];
+                out_r[i] += ch_r[i];
+            }
+        }
+#else
+        fluid_synth_write_float(plugin->synth, chunk_size,
+                              plugin->audio_out_l, offset, 1,
+                              plugin->audio_out_r, offset, 1);
+#endif
+
+        frames -= chunk_size;
+        offset += chunk_size;
+    }
 }
 
 /*
- * Handle program changes with proper bank selection
+ * CPU time used by this thread since start, in percent of the period of
+ * sample_count frames
  */
-static void handle_program_change(Plugin* plugin, int program) {
-    if (program < 0 || program >= plugin->program_count) {
-        if (plugin->debug) {
-            fprintf(stderr, "Invalid program number: %d (max: %d)\n", 
-                    program, plugin->program_count - 1);
-        }
-        return;
-    }
+static float cycle_load(const Plugin* plugin, const struct timespec* start, uint32_t sample_count)
+{
+    struct timespec end;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end);
 
-    // Reset all notes and sounds
-    fluid_synth_all_notes_off(plugin->synth, -1);
-    fluid_synth_all_sounds_off(plugin->synth, -1);
+    double period = sample_count / plugin->rate;
+    double elapsed = (double)(end.tv_sec - start->tv_sec) + (end.tv_nsec - start->tv_nsec) * 1e-9;
+    return (float)(100.0 * elapsed / period);
+}
 
-    int bank = plugin->programs[program].bank;
-    int prog = plugin->programs[program].prog;
+/*
+ * Adjust the voice limit to the measured load of the last cycle.
+ * Rendering cost is roughly proportional to the number of sounding voices,
+ * so an over-budget cycle scales the limit down to fit the budget at once;
+ * the limit then recovers gradually once the load settles
+ */
+static void governor_update(Plugin* plugin, float load, uint32_t sample_count)
+{
+    plugin->load_avg += (load - plugin->load_avg) * GOVERNOR_SMOOTHING;
 
-    if (plugin->debug) {
-        fprintf(stderr, "Changing to program %d (bank:%d prog:%d)\n", 
-                program, bank, prog);
+    int limit = plugin->voice_limit;
+    if (load > plugin->dsp_budget) {
+        int active = fluid_synth_get_active_voice_count(plugin->synth);
+        int target = (int)(active * (plugin->dsp_budget / load) * GOVERNOR_MARGIN);
+        if (target < limit) {
+            limit = target;
+        }
+        plugin->calm_frames = 0;
+    } else if (plugin->load_avg < plugin->dsp_budget * GOVERNOR_RAISE_LOAD) {
+        plugin->calm_frames += sample_count;
+        if (plugin->calm_frames >= plugin->rate * GOVERNOR_RAISE_HOLD) {
+            int step = plugin->max_polyphony / GOVERNOR_RAISE_STEPS;
+            limit += (step > 0) ? step : 1;
+            plugin->calm_frames = 0;
+        }
+    } else {
+        plugin->calm_frames = 0;
     }
 
-    // Reset CCs (cutoff to max, others to 0)
-    fluid_synth_cc(plugin->synth, 0, CC_CUTOFF, 127);    // Cutoff fully open
-    fluid_synth_cc(plugin->synth, 0, CC_RESONANCE, 0);
-    fluid_synth_cc(plugin->synth, 0, CC_ATTACK, 0);
-    fluid_synth_cc(plugin->synth, 0, CC_DECAY, 0);
-    fluid_synth_cc(plugin->synth, 0, CC_SUSTAIN, 0);
-    fluid_synth_cc(plugin->synth, 0, CC_RELEASE, 0);
+    int min_voices = (plugin->max_polyphony < GOVERNOR_MIN_VOICES) ? plugin->max_polyphony : GOVERNOR_MIN_VOICES;
+    if (limit < min_voices) {
+        limit = min_voices;
+    } else if (limit > plugin->max_polyphony) {
+        limit = plugin->max_polyphony;
+    }
 
-    // Send bank select first
-    fluid_synth_bank_select(plugin->synth, 0, bank);
-    
-    // Then send program change
-    int result = fluid_synth_program_change(plugin->synth, 0, prog);
-    
-    if (result != FLUID_OK) {
-        if (plugin->debug) {
-            fprintf(stderr, "Failed to change program: bank=%d prog=%d\n", bank, prog);
-        }
+    if (limit != plugin->voice_limit) {
+        // Within the allocated voices, so this does not allocate. Voices
+        // above a lowered limit are stopped by FluidSynth
+        fluid_synth_set_polyphony(plugin->synth, limit);
+        plugin->voice_limit = limit;
     }
+}
 
-    if (plugin->debug) {
-        // Debug output showing FluidSynth CC values
-        int cc_value;
-        fprintf(stderr, "CC values after program change:\n");
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_CUTOFF, &cc_value);
-        fprintf(stderr, "  Cutoff (CC%d): %d\n", CC_CUTOFF, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_RESONANCE, &cc_value);
-        fprintf(stderr, "  Resonance (CC%d): %d\n", CC_RESONANCE, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_ATTACK, &cc_value);
-        fprintf(stderr, "  Attack (CC%d): %d\n", CC_ATTACK, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_DECAY, &cc_value);
-        fprintf(stderr, "  Decay (CC%d): %d\n", CC_DECAY, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_SUSTAIN, &cc_value);
-        fprintf(stderr, "  Sustain (CC%d): %d\n", CC_SUSTAIN, cc_value);
-        
-        fluid_synth_get_cc(plugin->synth, 0, CC_RELEASE, &cc_value);
-        fprintf(stderr, "  Release (CC%d): %d\n", CC_RELEASE, cc_value);
+#if IDLE_SKIP
+/*
+ * Fill all audio outputs with silence for an idle cycle
+ */
+static void write_silence(Plugin* plugin, uint32_t frames)
+{
+    memset(plugin->audio_out_l, 0, frames * sizeof(float));
+    memset(plugin->audio_out_r, 0, frames * sizeof(float));
+#if CHANNEL_OUTPUTS
+    for (int i = 0; i < 2 * MIDI_CHANNELS; i++) {
+        memset(plugin->channel_out[i], 0, frames * sizeof(float));
     }
+#endif
 }
+#endif
 
 /*
  * Initialize a new instance of the plugin
@@ -326,7 +1577,8 @@ LV2_Handle instantiate(const LV2_Descriptor* descriptor,
     plugin->debug = (debug_env && (strcmp(debug_env, "1") == 0 || strcmp(debug_env, "true") == 0));
     
     if (plugin->debug) {
-        fprintf(stderr, "Instantiating %s plugin with debug enabled\n", PLUGIN_DISPLAY_NAME);
+        fprintf(stderr, "Instantiating %s plugin with debug enabled\n",
+                ((const PluginDescriptor*)descriptor)->name);
         fprintf(stderr, "Bundle path: %s\n", bundle_path);
     }
 
@@ -334,9 +1586,14 @@ LV2_Handle instantiate(const LV2_Descriptor* descriptor,
     plugin->bundle_path = strdup(bundle_path);
     
     // Get host features
+    const LV2_Options_Option* options = NULL;
     for (int i = 0; features[i]; ++i) {
         if (!strcmp(features[i]->URI, LV2_URID__map)) {
             plugin->map = (LV2_URID_Map*)features[i]->data;
+        } else if (!strcmp(features[i]->URI, LV2_WORKER__schedule)) {
+            plugin->schedule = (LV2_Worker_Schedule*)features[i]->data;
+        } else if (!strcmp(features[i]->URI, LV2_OPTIONS__options)) {
+            options = (const LV2_Options_Option*)features[i]->data;
         }
     }
 
@@ -350,6 +1607,12 @@ LV2_Handle instantiate(const LV2_Descriptor* descriptor,
     // Initialize URIs and basic plugin data
     map_uris(plugin->map, &plugin->urids);
     plugin->rate = rate;
+
+    // Voice and thread counts: build-time defaults, overridden by host options
+    int polyphony = POLYPHONY;
+    int cpu_cores = CPU_CORES;
+    plugin->dsp_budget = DSP_BUDGET;
+    read_options(plugin, options, &polyphony, &cpu_cores);
     
     // Initialize FluidSynth settings
     plugin->settings = new_fluid_settings();
@@ -360,14 +1623,19 @@ LV2_Handle instantiate(const LV2_Descriptor* descriptor,
     }
     
     // Configure FluidSynth settings for optimal performance
-    fluid_settings_setint(plugin->settings, "synth.threadsafe-api", 1);
+    fluid_settings_setint(plugin->settings, "synth.threadsafe-api", LOCKFREE_API ? 0 : 1);
     fluid_settings_setint(plugin->settings, "audio.period-size", 256);
     fluid_settings_setint(plugin->settings, "audio.periods", 2);
     fluid_settings_setnum(plugin->settings, "synth.sample-rate", rate);
-    fluid_settings_setint(plugin->settings, "synth.cpu-cores", 4);
-    fluid_settings_setint(plugin->settings, "synth.polyphony", 16);
+    fluid_settings_setint(plugin->settings, "synth.cpu-cores", cpu_cores);
+    fluid_settings_setint(plugin->settings, "synth.polyphony", polyphony);
     fluid_settings_setint(plugin->settings, "synth.reverb.active", 0);
     fluid_settings_setint(plugin->settings, "synth.chorus.active", 0);
+#if CHANNEL_OUTPUTS
+    // One audio group per MIDI channel for the per-channel outputs
+    fluid_settings_setint(plugin->settings, "synth.audio-groups", MIDI_CHANNELS);
+    fluid_settings_setint(plugin->settings, "synth.audio-channels", MIDI_CHANNELS);
+#endif
     
     // Create FluidSynth instance
     plugin->synth = new_fluid_synth(plugin->settings);
@@ -387,21 +1655,16 @@ LV2_Handle instantiate(const LV2_Descriptor* descriptor,
         return NULL;
     }
     
-    // Allocate audio processing buffers
-    plugin->buffer_l = (float*)calloc(BUFFER_SIZE, sizeof(float));
-    plugin->buffer_r = (float*)calloc(BUFFER_SIZE, sizeof(float));
-    if (!plugin->buffer_l || !plugin->buffer_r) {
-        if (plugin->buffer_l) free(plugin->buffer_l);
-        if (plugin->buffer_r) free(plugin->buffer_r);
-        delete_fluid_synth(plugin->synth);
-        delete_fluid_settings(plugin->settings);
-        free(plugin->bundle_path);
-        free(plugin);
-        return NULL;
-    }
-    
     // Initialize plugin state
     plugin->current_program = -1;
+    plugin->requested_program = -1;
+    atomic_init(&plugin->commands.head, 0);
+    atomic_init(&plugin->commands.tail, 0);
+    for (int chan = 0; chan < MIDI_CHANNELS; chan++) {
+        plugin->commands.held[chan] = -1;
+    }
+    plugin->max_polyphony = fluid_synth_get_polyphony(plugin->synth);
+    plugin->voice_limit = plugin->max_polyphony;
     
     // Initialize prev values
     plugin->prev_cutoff = 1.0f;     // Start with cutoff open
@@ -461,6 +1724,18 @@ void connect_port(LV2_Handle instance,
         case PORT_RELEASE:
             plugin->release_port = (float*)data;
             break;
+        default:
+#if CHANNEL_OUTPUTS
+            if (port >= PORT_CHANNEL_OUT && port < PORT_CHANNEL_OUT + 2 * MIDI_CHANNELS) {
+                plugin->channel_out[port - PORT_CHANNEL_OUT] = (float*)data;
+            }
+#endif
+#if PERF_PORTS
+            if (port >= PORT_PERF_FIRST && port < PORT_PERF_FIRST + PERF_PORT_COUNT) {
+                plugin->perf_ports[port - PORT_PERF_FIRST] = (float*)data;
+            }
+#endif
+            break;
     }
 }
 
@@ -472,8 +1747,14 @@ void connect_port(LV2_Handle instance,
 void activate(LV2_Handle instance)
 {
     Plugin* plugin = (Plugin*)instance;
+    plugin->voice_steals = 0;
+    plugin->peak_load = 0.0f;
+    plugin->silent_frames = 0;
+    plugin->idle = false;
+    lock_samples(plugin);
     fluid_synth_all_notes_off(plugin->synth, -1);
     fluid_synth_all_sounds_off(plugin->synth, -1);
+    unlock_samples(plugin);
 }
 
 /*
@@ -482,19 +1763,56 @@ void activate(LV2_Handle instance)
  * Handles:
  * 1. Program changes
  * 2. Control parameter updates (only when values change)
- * 3. MIDI event processing
+ * 3. MIDI event processing, interleaved with audio generation so that
+ *    each event takes effect at its frame offset (SAMPLE_ACCURATE)
  * 4. Audio generation
  */
 void run(LV2_Handle instance, uint32_t sample_count)
 {
     Plugin* plugin = (Plugin*)instance;
 
-    // Handle program changes first - if program changes, skip control updates
+    // The governor and the performance counters measure CPU time used by
+    // this thread, so time spent preempted by other threads does not count
+    bool measure = (PERF_PORTS || plugin->dsp_budget > 0) && sample_count > 0;
+    struct timespec start;
+    if (measure) {
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start);
+    }
+    uint32_t event_count = 0;
+
+    // Other instances of the SoundFont play the same samples; wait for any
+    // of them still rendering, or for a worker pinning samples
+    lock_samples(plugin);
+
+    // Program changes the worker has finished loading, then those that
+    // could not be handed on in earlier cycles
+    run_commands(plugin);
+#if MULTITIMBRAL
+    run_deferred_programs(plugin);
+#endif
+
+    // Handle program changes first - if program changes, skip control updates.
+    // When the host provides a worker, the change (which may load samples)
+    // loads there and is applied by run_commands()
     if (plugin->program_port) {
         int new_program = (int)(*plugin->program_port + 0.5);
-        if (new_program != plugin->current_program && new_program >= 0) {
+        if (plugin->schedule) {
+            if (new_program != plugin->requested_program && new_program >= 0) {
+                WorkMessage msg = { WORK_PROGRAM_CHANGE, new_program, 0, 0 };
+                if (plugin->schedule->schedule_work(plugin->schedule->handle,
+                                                    sizeof(msg), &msg) == LV2_WORKER_SUCCESS) {
+                    plugin->requested_program = new_program;
+                    plugin->program_pending = true;
+                    plugin->idle = false;
+                }
+            }
+            if (plugin->program_pending) {
+                goto process_audio;  // The worker resets the CCs when it switches
+            }
+        } else if (new_program != plugin->current_program && new_program >= 0) {
             handle_program_change(plugin, new_program);
             plugin->current_program = new_program;
+            plugin->idle = false;
             goto process_audio;  // Skip control updates after program change
         }
     }
@@ -504,36 +1822,42 @@ void run(LV2_Handle instance, uint32_t sample_count)
         int cc_value = (int)(*plugin->cutoff_port * 127.0f);
         fluid_synth_cc(plugin->synth, 0, CC_CUTOFF, cc_value);
         plugin->prev_cutoff = *plugin->cutoff_port;
+        plugin->idle = false;
     }
 
     if (plugin->resonance_port && *plugin->resonance_port != plugin->prev_resonance) {
         int cc_value = (int)(*plugin->resonance_port * 127.0f);
         fluid_synth_cc(plugin->synth, 0, CC_RESONANCE, cc_value);
         plugin->prev_resonance = *plugin->resonance_port;
+        plugin->idle = false;
     }
 
     if (plugin->attack_port && *plugin->attack_port != plugin->prev_attack) {
         int cc_value = (int)(*plugin->attack_port * 127.0f);
         fluid_synth_cc(plugin->synth, 0, CC_ATTACK, cc_value);
         plugin->prev_attack = *plugin->attack_port;
+        plugin->idle = false;
     }
 
     if (plugin->decay_port && *plugin->decay_port != plugin->prev_decay) {
         int cc_value = (int)(*plugin->decay_port * 127.0f);
         fluid_synth_cc(plugin->synth, 0, CC_DECAY, cc_value);
         plugin->prev_decay = *plugin->decay_port;
+        plugin->idle = false;
     }
 
     if (plugin->sustain_port && *plugin->sustain_port != plugin->prev_sustain) {
         int cc_value = (int)(*plugin->sustain_port * 127.0f);
         fluid_synth_cc(plugin->synth, 0, CC_SUSTAIN, cc_value);
         plugin->prev_sustain = *plugin->sustain_port;
+        plugin->idle = false;
     }
 
     if (plugin->release_port && *plugin->release_port != plugin->prev_release) {
         int cc_value = (int)(*plugin->release_port * 127.0f);
         fluid_synth_cc(plugin->synth, 0, CC_RELEASE, cc_value);
         plugin->prev_release = *plugin->release_port;
+        plugin->idle = false;
     }
 
 process_audio:
@@ -543,51 +1867,432 @@ process_audio:
         fluid_synth_set_gain(plugin->synth, level);
     }
 
-    // Process incoming MIDI events
+#if IDLE_SKIP
+    // Nothing is sounding and nothing has arrived: the synth would only
+    // render silence, so write it directly
+    if (plugin->idle && plugin->events_in->atom.size <= sizeof(LV2_Atom_Sequence_Body)) {
+        write_silence(plugin, sample_count);
+        goto cycle_done;
+    }
+#endif
+
+    // Process incoming MIDI events. In sample-accurate mode audio is rendered
+    // up to each event's frame offset before the event is applied
+    uint32_t rendered = 0;
     LV2_ATOM_SEQUENCE_FOREACH(plugin->events_in, ev) {
-        if (ev->body.type == plugin->urids.midi_Event) {
-            const uint8_t* const msg = (const uint8_t*)(ev + 1);
-            switch (msg[0] & 0xF0) {
-                case 0x90:  // Note On (velocity > 0) or Note Off (velocity = 0)
-                    if (msg[2] > 0) {
-                        fluid_synth_noteon(plugin->synth, 0, msg[1], msg[2]);
-                    } else {
-                        fluid_synth_noteoff(plugin->synth, 0, msg[1]);
-                    }
-                    break;
-                case 0x80:  // Note Off
-                    fluid_synth_noteoff(plugin->synth, 0, msg[1]);
-                    break;
-                case 0xB0:  // Control Change
-                    fluid_synth_cc(plugin->synth, 0, msg[1], msg[2]);
-                    break;
-                case 0xE0:  // Pitch Bend (14-bit value from two 7-bit values)
-                    fluid_synth_pitch_bend(plugin->synth, 0,
-                        (msg[2] << 7) | msg[1]);
-                    break;
+        if (ev->body.type != plugin->urids.midi_Event) {
+            continue;
+        }
+#if SAMPLE_ACCURATE
+        int64_t frame = ev->time.frames;
+        if (frame > (int64_t)sample_count) {
+            frame = sample_count;
+        }
+        if (frame >= (int64_t)rendered + MIN_SUBBLOCK) {
+            render_audio(plugin, rendered, (uint32_t)frame - rendered);
+            rendered = (uint32_t)frame;
+        }
+#endif
+        handle_midi_event(plugin, (const uint8_t*)(ev + 1));
+        event_count++;
+    }
+
+    // Render the remainder of the cycle
+    render_audio(plugin, rendered, sample_count - rendered);
+
+#if IDLE_SKIP
+    // Go idle once the last voice has been silent for the tail time
+    if (fluid_synth_get_active_voice_count(plugin->synth) > 0) {
+        plugin->silent_frames = 0;
+    } else if (plugin->silent_frames < plugin->rate * IDLE_TAIL_MS / 1000.0) {
+        plugin->silent_frames += sample_count;
+    }
+    plugin->idle = (plugin->silent_frames >= plugin->rate * IDLE_TAIL_MS / 1000.0);
+
+cycle_done:
+#endif
+
+    if (measure) {
+        float load = cycle_load(plugin, &start, sample_count);
+        if (plugin->dsp_budget > 0) {
+            governor_update(plugin, load, sample_count);
+        }
+#if PERF_PORTS
+        if (load > plugin->peak_load) {
+            plugin->peak_load = load;
+        }
+        float values[PERF_PORT_COUNT] = {
+            [PERF_VOICES] = (float)fluid_synth_get_active_voice_count(plugin->synth),
+            [PERF_VOICE_STEALS] = (float)plugin->voice_steals,
+            [PERF_LOAD] = load,
+            [PERF_PEAK_LOAD] = plugin->peak_load,
+            [PERF_EVENTS] = (float)event_count,
+        };
+        for (int i = 0; i < PERF_PORT_COUNT; i++) {
+            if (plugin->perf_ports[i]) {
+                *plugin->perf_ports[i] = fminf(values[i], perf_maximum[i]);
             }
         }
+#endif
     }
 
-    // Generate audio in chunks of BUFFER_SIZE
-    uint32_t remaining = sample_count;
-    uint32_t offset = 0;
+    // The governor may have stopped voices, releasing their samples
+    unlock_samples(plugin);
+}
 
-    while (remaining > 0) {
-        uint32_t chunk_size = (remaining > BUFFER_SIZE) ? BUFFER_SIZE : remaining;
+/*
+ * Load the samples a preset needs before it is selected on a channel, so the
+ * selection itself does not read the SoundFont. Called off the audio thread
+ * Returns: The pin to drop with sfont_cache_unpin() once the preset is selected
+ */
+static int preload_program(Plugin* plugin, int chan, int bank, int prog)
+{
+    // FluidSynth plays drum kits from bank 128 on channel 10
+    if (MULTITIMBRAL && chan == DRUM_CHANNEL) {
+        bank = 128;
+    }
+    BankProgram key = { bank, prog, 0, 0 };
+    const BankProgram* entry = bsearch(&key, plugin->programs, plugin->program_count,
+                                       sizeof(BankProgram), compare_programs);
+    if (entry && entry->range_count > 0) {
+        sfont_cache_prefetch(plugin->sfont_entry,
+                             plugin->ranges + entry->first_range, entry->range_count);
+    }
+    return sfont_cache_pin(plugin->sfont_entry, bank, prog);
+}
 
-        // Generate audio for current chunk
-        fluid_synth_write_float(plugin->synth, chunk_size,
-                              plugin->buffer_l, 0, 1,
-                              plugin->buffer_r, 0, 1);
+/*
+ * Perform scheduled work on the host's worker thread.
+ * Only the samples of the new program are loaded here, so that disk reads
+ * stay off the audio thread. The switch itself (notes off, CC reset, preset
+ * selection) is posted to run(), which would otherwise wait on FluidSynth's
+ * API mutex for as long as the worker held it
+ */
+static LV2_Worker_Status work(LV2_Handle instance,
+            LV2_Worker_Respond_Function respond,
+            LV2_Worker_Respond_Handle handle,
+            uint32_t size,
+            const void* data)
+{
+    Plugin* plugin = (Plugin*)instance;
+    const WorkMessage* msg = (const WorkMessage*)data;
 
-        // Copy generated audio to output ports
-        memcpy(plugin->audio_out_l + offset, plugin->buffer_l, chunk_size * sizeof(float));
-        memcpy(plugin->audio_out_r + offset, plugin->buffer_r, chunk_size * sizeof(float));
+    if (size != sizeof(WorkMessage)) {
+        return LV2_WORKER_ERR_UNKNOWN;
+    }
 
-        remaining -= chunk_size;
-        offset += chunk_size;
+    // The samples stay pinned until run() has applied the command
+    WorkMessage cmd = *msg;
+    cmd.pin = -1;
+    switch (msg->type) {
+        case WORK_PROGRAM_CHANGE:
+            if (msg->program >= 0 && msg->program < plugin->program_count) {
+                const BankProgram* entry = &plugin->programs[msg->program];
+                if (entry->range_count > 0) {
+                    sfont_cache_prefetch(plugin->sfont_entry,
+                                         plugin->ranges + entry->first_range, entry->range_count);
+                }
+                cmd.pin = sfont_cache_pin(plugin->sfont_entry, entry->bank, entry->prog);
+            }
+            break;
+#if MULTITIMBRAL
+        case WORK_CHANNEL_PROGRAM:
+            cmd.pin = preload_program(plugin, msg->channel, msg->bank, msg->program);
+            break;
+#endif
+        default:
+            return LV2_WORKER_ERR_UNKNOWN;
+    }
+
+    cmd.dropped = !command_ring_push(&plugin->commands, &cmd, plugin->sfont_entry);
+    if (cmd.dropped) {
+        sfont_cache_unpin(plugin->sfont_entry, cmd.pin);
+        if (plugin->debug) {
+            fprintf(stderr, "Command ring full, dropping program change\n");
+        }
+    }
+
+    // Report completion back to the audio thread
+    return respond(handle, sizeof(cmd), &cmd);
+}
+
+/*
+ * Apply the result of scheduled work.
+ * Called by the host in the audio thread, so it only updates plugin state
+ */
+static LV2_Worker_Status work_response(LV2_Handle instance,
+            uint32_t size,
+            const void* data)
+{
+    Plugin* plugin = (Plugin*)instance;
+    const WorkMessage* msg = (const WorkMessage*)data;
+
+    if (size != sizeof(WorkMessage)) {
+        return LV2_WORKER_ERR_UNKNOWN;
+    }
+
+    // A dropped change never reaches the synth. Unless a newer one replaced
+    // it, run() requests it again: the program port compares against
+    // requested_program, channel changes are retried while deferred
+    if (msg->dropped) {
+        if (msg->type == WORK_PROGRAM_CHANGE && plugin->program_pending &&
+            msg->program == plugin->requested_program) {
+            plugin->requested_program = plugin->current_program;
+            plugin->program_pending = false;
+        }
+#if MULTITIMBRAL
+        if (msg->type == WORK_CHANNEL_PROGRAM && msg->channel >= 0 && msg->channel < MIDI_CHANNELS) {
+            ChannelProgram* change = &plugin->channel_programs[msg->channel];
+            if (change->bank == msg->bank && change->prog == msg->program) {
+                change->deferred = true;
+            }
+        }
+#endif
+    }
+
+    // Queued changes update the program state when run() applies them
+    return LV2_WORKER_SUCCESS;
+}
+
+/*
+ * Controllers restored from saved state. Data entry and increment/decrement
+ * (CC 6, 38, 96, 97) act on whichever parameter is selected, and the channel
+ * mode messages (CC 120-127) are commands, so replaying them restores nothing
+ */
+static bool cc_is_state(int cc)
+{
+    return cc != 6 && cc != 38 && cc != 96 && cc != 97 && cc < 120;
+}
+
+/*
+ * Save the plugin state: the program port's program, the control values in
+ * effect, the program, pitch bend and controllers of every played channel,
+ * and the polyphony and DSP budget options.
+ * The host may call this while run() is active; FluidSynth's thread-safe API
+ * covers the reads from the synth. With LOCKFREE_API they are unlocked reads
+ * of plain integers, at worst from just before or after an event
+ */
+static LV2_State_Status save(LV2_Handle instance,
+            LV2_State_Store_Function store,
+            LV2_State_Handle handle,
+            uint32_t flags,
+            const LV2_Feature* const* features)
+{
+    Plugin* plugin = (Plugin*)instance;
+    const URIDs* uris = &plugin->urids;
+    const uint32_t pod = LV2_STATE_IS_POD | LV2_STATE_IS_PORTABLE;
+
+    struct {
+        LV2_Atom_Vector_Body body;
+        float values[6];
+    } controls = {
+        { sizeof(float), uris->atom_Float },
+        { plugin->prev_cutoff, plugin->prev_resonance, plugin->prev_attack,
+          plugin->prev_decay, plugin->prev_sustain, plugin->prev_release }
+    };
+
+    struct {
+        LV2_Atom_Vector_Body body;
+        int32_t values[STATE_CHANNELS * CHANNEL_STATE_SIZE];
+    } channels = { { sizeof(int32_t), uris->atom_Int }, { 0 } };
+
+    for (int chan = 0; chan < STATE_CHANNELS; chan++) {
+        int32_t* values = channels.values + chan * CHANNEL_STATE_SIZE;
+        int sfont_id, bank = 0, prog = 0, value = 0;
+
+        fluid_synth_get_program(plugin->synth, chan, &sfont_id, &bank, &prog);
+        values[CHANNEL_STATE_BANK] = bank;
+        values[CHANNEL_STATE_PROGRAM] = prog;
+        fluid_synth_get_pitch_bend(plugin->synth, chan, &value);
+        values[CHANNEL_STATE_PITCH_BEND] = value;
+        fluid_synth_get_pitch_wheel_sens(plugin->synth, chan, &value);
+        values[CHANNEL_STATE_WHEEL_SENS] = value;
+        for (int cc = 0; cc < 128; cc++) {
+            fluid_synth_get_cc(plugin->synth, chan, cc, &value);
+            values[CHANNEL_STATE_CC + cc] = value;
+        }
+    }
+
+    // A program still loading on the worker is the one to come back to
+    int32_t program = plugin->program_pending ? plugin->requested_program
+                                              : plugin->current_program;
+    int32_t polyphony = plugin->max_polyphony;
+    float dsp_budget = plugin->dsp_budget;
+
+    LV2_State_Status status = LV2_STATE_SUCCESS;
+    if (program >= 0) {
+        status = store(handle, uris->program, &program, sizeof(program), uris->atom_Int, pod);
+    }
+    if (status == LV2_STATE_SUCCESS) {
+        status = store(handle, uris->controls, &controls, sizeof(controls), uris->atom_Vector, pod);
+    }
+    if (status == LV2_STATE_SUCCESS) {
+        status = store(handle, uris->channels, &channels, sizeof(channels), uris->atom_Vector, pod);
+    }
+    if (status == LV2_STATE_SUCCESS) {
+        status = store(handle, uris->polyphony, &polyphony, sizeof(polyphony), uris->atom_Int, pod);
+    }
+    if (status == LV2_STATE_SUCCESS) {
+        status = store(handle, uris->dsp_budget, &dsp_budget, sizeof(dsp_budget), uris->atom_Float, pod);
+    }
+    return status;
+}
+
+/*
+ * Read a numeric state property (atom:Int or atom:Float).
+ * Returns: true if the property is present with a usable value
+ */
+static bool state_number(Plugin* plugin, LV2_State_Retrieve_Function retrieve,
+                         LV2_State_Handle handle, LV2_URID key, double* number)
+{
+    size_t size = 0;
+    uint32_t type = 0, flags = 0;
+    const void* value = retrieve(handle, key, &size, &type, &flags);
+    LV2_Options_Option opt = { LV2_OPTIONS_INSTANCE, 0, key, (uint32_t)size, type, value };
+    return value && option_value(&plugin->urids, &opt, number);
+}
+
+/*
+ * Read a state vector with elements of the given type.
+ * Returns: the elements (their number in count), or NULL if the property
+ *          is missing or of another type
+ */
+static const void* state_vector(Plugin* plugin, LV2_State_Retrieve_Function retrieve,
+                                LV2_State_Handle handle, LV2_URID key,
+                                LV2_URID child_type, uint32_t child_size, uint32_t* count)
+{
+    size_t size = 0;
+    uint32_t type = 0, flags = 0;
+    const LV2_Atom_Vector_Body* body = retrieve(handle, key, &size, &type, &flags);
+    if (!body || type != plugin->urids.atom_Vector || size < sizeof(*body) ||
+        body->child_type != child_type || body->child_size != child_size) {
+        return NULL;
+    }
+    *count = (uint32_t)((size - sizeof(*body)) / child_size);
+    return body + 1;
+}
+
+/*
+ * Restore saved state in one batch. The host does not call this while run()
+ * is active, so the whole restore (loading samples included) is applied here
+ * rather than through the worker: options first, then each channel's
+ * samples, controllers and program, then the program port and control values
+ * run() compares its ports against. Ports still at the restored values cause
+ * no further program change or controller reset. Besides run() this is the
+ * only place that changes the synth, which is safe without FluidSynth's API
+ * mutex (LOCKFREE_API) since the worker leaves the synth to run()
+ */
+static LV2_State_Status restore(LV2_Handle instance,
+            LV2_State_Retrieve_Function retrieve,
+            LV2_State_Handle handle,
+            uint32_t flags,
+            const LV2_Feature* const* features)
+{
+    Plugin* plugin = (Plugin*)instance;
+    const URIDs* uris = &plugin->urids;
+    double number;
+    uint32_t count = 0;
+
+    // Runtime options
+    int polyphony = plugin->max_polyphony;
+    if (state_number(plugin, retrieve, handle, uris->polyphony, &number) &&
+        number >= 1 && number <= 65535) {
+        polyphony = (int)number;
+    }
+    if (state_number(plugin, retrieve, handle, uris->dsp_budget, &number) &&
+        number >= 0 && number <= 100) {
+        plugin->dsp_budget = (float)number;
+        plugin->load_avg = 0.0f;
+    }
+
+    // Program changes queued before the restore would undo it
+    command_ring_clear(&plugin->commands);
+#if MULTITIMBRAL
+    memset(plugin->channel_programs, 0, sizeof(plugin->channel_programs));
+#endif
+
+    // Start from the full voice count (the governor cuts it again if it is
+    // on); a larger polyphony reallocates the synth's voices. Stopping
+    // voices releases their samples, hence the sample lock
+    lock_samples(plugin);
+    if ((polyphony != plugin->max_polyphony || plugin->voice_limit != polyphony) &&
+        fluid_synth_set_polyphony(plugin->synth, polyphony) == FLUID_OK) {
+        plugin->max_polyphony = polyphony;
+        plugin->voice_limit = polyphony;
+    }
+    fluid_synth_all_notes_off(plugin->synth, -1);
+    fluid_synth_all_sounds_off(plugin->synth, -1);
+    unlock_samples(plugin);
+
+    // Channel state: programs, pitch bend and controllers
+    const int32_t* channels = state_vector(plugin, retrieve, handle, uris->channels,
+                                           uris->atom_Int, sizeof(int32_t), &count);
+    int restored = (channels && count % CHANNEL_STATE_SIZE == 0) ? count / CHANNEL_STATE_SIZE : 0;
+    if (restored > STATE_CHANNELS) {
+        restored = STATE_CHANNELS;
+    }
+    for (int chan = 0; chan < restored; chan++) {
+        const int32_t* values = channels + chan * CHANNEL_STATE_SIZE;
+        int bank = values[CHANNEL_STATE_BANK];
+        int prog = values[CHANNEL_STATE_PROGRAM];
+
+        int pin = preload_program(plugin, chan, bank, prog);
+        for (int cc = 0; cc < 128; cc++) {
+            if (cc_is_state(cc)) {
+                fluid_synth_cc(plugin->synth, chan, cc, values[CHANNEL_STATE_CC + cc]);
+            }
+        }
+        fluid_synth_pitch_wheel_sens(plugin->synth, chan, values[CHANNEL_STATE_WHEEL_SENS]);
+        fluid_synth_pitch_bend(plugin->synth, chan, values[CHANNEL_STATE_PITCH_BEND]);
+        lock_samples(plugin);
+        apply_channel_program(plugin, chan, bank, prog);
+        unlock_samples(plugin);
+        sfont_cache_unpin(plugin->sfont_entry, pin);
+    }
+
+    // Program port; without channel state the program is selected from it
+    if (state_number(plugin, retrieve, handle, uris->program, &number) &&
+        number >= 0 && number < plugin->program_count) {
+        int program = (int)number;
+        if (restored == 0) {
+            const BankProgram* entry = &plugin->programs[program];
+            int pin = preload_program(plugin, 0, entry->bank, entry->prog);
+            lock_samples(plugin);
+            handle_program_change(plugin, program);
+            unlock_samples(plugin);
+            sfont_cache_unpin(plugin->sfont_entry, pin);
+        }
+        plugin->current_program = program;
+        plugin->requested_program = program;
+    }
+    plugin->program_pending = false;
+
+    // Control values in effect; without channel state they are sent as CCs
+    const float* controls = state_vector(plugin, retrieve, handle, uris->controls,
+                                         uris->atom_Float, sizeof(float), &count);
+    if (controls && count == 6) {
+        static const int control_ccs[6] = {
+            CC_CUTOFF, CC_RESONANCE, CC_ATTACK, CC_DECAY, CC_SUSTAIN, CC_RELEASE
+        };
+        float* prev[6] = {
+            &plugin->prev_cutoff, &plugin->prev_resonance, &plugin->prev_attack,
+            &plugin->prev_decay, &plugin->prev_sustain, &plugin->prev_release
+        };
+        for (int i = 0; i < 6; i++) {
+            *prev[i] = controls[i];
+            if (restored == 0) {
+                fluid_synth_cc(plugin->synth, 0, control_ccs[i], (int)(controls[i] * 127.0f));
+            }
+        }
+    }
+
+    if (plugin->debug) {
+        fprintf(stderr, "Restored state: program %d, %d channel(s), polyphony %d\n",
+                plugin->current_program, restored, plugin->max_polyphony);
     }
+
+    plugin->idle = false;
+    return LV2_STATE_SUCCESS;
 }
 
 /*
@@ -598,8 +2303,10 @@ process_audio:
 void deactivate(LV2_Handle instance)
 {
     Plugin* plugin = (Plugin*)instance;
+    lock_samples(plugin);
     fluid_synth_all_notes_off(plugin->synth, -1);
     fluid_synth_all_sounds_off(plugin->synth, -1);
+    unlock_samples(plugin);
 }
 
 /*
@@ -612,16 +2319,30 @@ void cleanup(LV2_Handle instance)
     Plugin* plugin = (Plugin*)instance;
     
     if (plugin) {
-        // Free audio buffers
-        if (plugin->buffer_l) free(plugin->buffer_l);
-        if (plugin->buffer_r) free(plugin->buffer_r);
-        
         // Free program data
         if (plugin->programs) free(plugin->programs);
+        if (plugin->ranges) free(plugin->ranges);
         
+        // Detach the shared SoundFont so deleting the synth does not free it,
+        // first dropping the pins of commands the worker left behind.
+        // Detaching unselects this synth's presets and deleting the synth
+        // releases the samples its voices still hold, so both hold the
+        // sample lock
+        if (plugin->sfont_entry) {
+            command_ring_unpin_all(&plugin->commands, plugin->sfont_entry);
+            lock_samples(plugin);
+            fluid_synth_remove_sfont(plugin->synth, plugin->sfont_entry->sfont);
+            delete_fluid_synth(plugin->synth);
+            plugin->synth = NULL;
+            unlock_samples(plugin);
+        }
+
         // Delete FluidSynth instances
         if (plugin->synth) delete_fluid_synth(plugin->synth);
         if (plugin->settings) delete_fluid_settings(plugin->settings);
+
+        // Release the shared SoundFont after the synth no longer references it
+        if (plugin->sfont_entry) sfont_cache_release(plugin->sfont_entry);
         
         // Free bundle path
         if (plugin->bundle_path) free(plugin->bundle_path);
@@ -633,36 +2354,129 @@ void cleanup(LV2_Handle instance)
 
 /*
  * Extension data interface.
- * Returns NULL as this plugin doesn't implement any extensions.
+ * Returns the worker and state interfaces; no other extensions are implemented.
  */
 const void* extension_data(const char* uri)
 {
+    static const LV2_Worker_Interface worker = { work, work_response, NULL };
+    static const LV2_State_Interface state = { save, restore };
+
+    if (!strcmp(uri, LV2_WORKER__interface)) {
+        return &worker;
+    }
+    if (!strcmp(uri, LV2_STATE__interface)) {
+        return &state;
+    }
     return NULL;
 }
 
 /*
- * Plugin descriptor.
+ * Fallback plugin descriptor, named at compile time.
  * Contains all function pointers required by the LV2 specification.
  */
-static const LV2_Descriptor descriptor = {
-    PLUGIN_URI,            // Unique URI identifying the plugin
-    instantiate,           // Create new instance of the plugin
-    connect_port,          // Connect plugin ports to host buffers
-    activate,             // Prepare plugin for audio processing
-    run,                  // Process audio and MIDI events
-    deactivate,           // Stop audio processing
-    cleanup,              // Free plugin resources
-    extension_data        // Plugin extensions (none implemented)
+static const PluginDescriptor descriptor = {
+    {
+        PLUGIN_URI,            // Unique URI identifying the plugin
+        instantiate,           // Create new instance of the plugin
+        connect_port,          // Connect plugin ports to host buffers
+        activate,             // Prepare plugin for audio processing
+        run,                  // Process audio and MIDI events
+        deactivate,           // Stop audio processing
+        cleanup,              // Free plugin resources
+        extension_data        // Plugin extensions (worker)
+    },
+    PLUGIN_NAME
 };
 
+/* Library descriptor for one bundle, with the descriptor read from it */
+typedef struct {
+    LV2_Lib_Descriptor lib;
+    PluginDescriptor plugin;
+    char uri[1024];
+    char name[256];
+} BundleLibrary;
+
+/*
+ * Read the plugin URI and name from a bundle's descriptor file.
+ * Returns: 0 on success, -1 if the file is missing or has no URI
+ */
+static int read_bundle_desc(const char* bundle_path, BundleLibrary* library)
+{
+    char path[4096];
+    size_t len = strlen(bundle_path);
+    snprintf(path, sizeof(path), "%s%s%s", bundle_path,
+             (len > 0 && bundle_path[len - 1] == '/') ? "" : "/", BUNDLE_DESC_FILE);
+
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return -1;
+    }
+
+    char line[1280];
+    while (fgets(line, sizeof(line), file)) {
+        line[strcspn(line, "\r\n")] = '\0';
+        char* value = strchr(line, '=');
+        if (!value) {
+            continue;
+        }
+        *value++ = '\0';
+        if (!strcmp(line, BUNDLE_DESC_URI)) {
+            snprintf(library->uri, sizeof(library->uri), "%s", value);
+        } else if (!strcmp(line, BUNDLE_DESC_NAME)) {
+            snprintf(library->name, sizeof(library->name), "%s", value);
+        }
+    }
+    fclose(file);
+
+    return library->uri[0] ? 0 : -1;
+}
+
+static const LV2_Descriptor* bundle_get_plugin(LV2_Lib_Handle handle, uint32_t index)
+{
+    BundleLibrary* library = (BundleLibrary*)handle;
+    return (index == 0) ? &library->plugin.lv2 : NULL;
+}
+
+static void bundle_cleanup(LV2_Lib_Handle handle)
+{
+    free(handle);
+}
+
+/*
+ * Return the library descriptor for a bundle.
+ * Hosts that support it call this instead of lv2_descriptor(), passing the
+ * bundle path, so the plugin's URI and name can come from the bundle's
+ * descriptor file. Bundles without one get the compiled-in descriptor
+ */
+const LV2_Lib_Descriptor* lv2_lib_descriptor(const char* bundle_path,
+            const LV2_Feature* const* features)
+{
+    BundleLibrary* library = (BundleLibrary*)calloc(1, sizeof(BundleLibrary));
+    if (!library) {
+        return NULL;
+    }
+
+    library->plugin = descriptor;
+    if (bundle_path && read_bundle_desc(bundle_path, library) == 0) {
+        library->plugin.lv2.URI = library->uri;
+        library->plugin.name = library->name[0] ? library->name : library->uri;
+    }
+
+    library->lib.handle = library;
+    library->lib.size = sizeof(LV2_Lib_Descriptor);
+    library->lib.cleanup = bundle_cleanup;
+    library->lib.get_plugin = bundle_get_plugin;
+    return &library->lib;
+}
+
 /*
  * Return plugin descriptor.
- * This is the entry point required by the LV2 specification.
- * Returns the plugin descriptor for index 0, NULL for all other indices.
+ * Entry point for hosts without lv2_lib_descriptor() support.
+ * Returns the fallback descriptor for index 0, NULL for all other indices.
  */
 const LV2_Descriptor* lv2_descriptor(uint32_t index)
 {
-    return (index == 0) ? &descriptor : NULL;
+    return (index == 0) ? &descriptor.lv2 : NULL;
 }
 
 
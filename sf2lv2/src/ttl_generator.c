@@ -7,20 +7,75 @@
  * 2. Scans all available presets (including bank 128 for drum kits)
  * 3. Generates LV2 TTL files describing the plugin interface
  * 4. Creates a manifest file for LV2 plugin discovery
+ * 5. Writes a binary preset index for fast plugin instantiation
  */
 
+#define _GNU_SOURCE // copy_file_range
+
 #include <fluidsynth.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <linux/fs.h>
+#endif
 
-/* Plugin name should be defined at compile time using the make command, defaults to "undefined" */
+#include "sf2_hydra.h"
+#include "preset_index.h"
+#include "plugin_uris.h"
+#include "bundle_desc.h"
+
+/* Default plugin name when none is given on the command line; can be defined
+   at compile time, defaults to "undefined" */
 #ifndef PLUGIN_NAME
 #define PLUGIN_NAME "undefined"
 #endif
 
+/* Runtime options that change the plugin interface; must match the values the
+   plugin binary is built with (see makefile) */
+#ifndef MULTITIMBRAL
+#define MULTITIMBRAL 0
+#endif
+
+#ifndef CHANNEL_OUTPUTS
+#define CHANNEL_OUTPUTS 0
+#endif
+
+#ifndef PERF_PORTS
+#define PERF_PORTS 0
+#endif
+
+// First port index of the per-channel outputs (after the release control)
+#define CHANNEL_OUT_PORT 11
+
+// First port index of the performance counters (after any per-channel outputs)
+#define PERF_PORT (CHANNEL_OUT_PORT + (CHANNEL_OUTPUTS ? 32 : 0))
+
+#if PERF_PORTS
+/* Performance counter output ports, in the plugin's order. The maximums
+   match perf_maximum in synth_plugin.c, which clamps to them: voices up to
+   the largest polyphony option, the load above 100 for overrun cycles */
+static const struct {
+    const char* symbol;
+    const char* name;
+    int integer;        // Whole-number counter
+    int maximum;
+    const char* comment;
+} perf_ports[] = {
+    { "voices", "Voices", 1, 65535, "Active voices" },
+    { "voice_steals", "Voice Steals", 1, 1000000, "Note-ons that found every voice busy, since activation" },
+    { "dsp_load", "DSP Load", 0, 1000, "CPU time of the last cycle, in percent of the period" },
+    { "dsp_load_peak", "DSP Load Peak", 0, 1000, "Highest DSP load since activation" },
+    { "events", "Events", 1, 1024, "MIDI events handled in the last cycle" },
+};
+#endif
+
 /* Structure to store bank/program mapping information */
 struct PresetMapping {
     int bank;           // MIDI bank number
@@ -28,6 +83,209 @@ struct PresetMapping {
     const char* name;   // Preset name from SoundFont
 };
 
+/* Order presets by bank, then program */
+int compare_presets(const void* a, const void* b) {
+    const struct PresetMapping* pa = (const struct PresetMapping*)a;
+    const struct PresetMapping* pb = (const struct PresetMapping*)b;
+    if (pa->bank != pb->bank) {
+        return pa->bank - pb->bank;
+    }
+    return pa->prog - pb->prog;
+}
+
+/* Byte range of the SoundFont file holding sample data */
+struct ByteRange {
+    uint64_t offset;    // File offset of the first byte
+    uint64_t length;    // Number of bytes
+};
+
+/* Order byte ranges by offset */
+int compare_ranges(const void* a, const void* b) {
+    const struct ByteRange* ra = (const struct ByteRange*)a;
+    const struct ByteRange* rb = (const struct ByteRange*)b;
+    return (ra->offset > rb->offset) - (ra->offset < rb->offset);
+}
+
+/* Append a range to a growable array. Returns 0 on success, -1 when out of memory */
+int append_range(struct ByteRange** ranges, uint32_t* count, uint32_t* capacity,
+                 uint64_t offset, uint64_t end) {
+    if (*count == *capacity) {
+        uint32_t grown_capacity = *capacity ? *capacity * 2 : 256;
+        struct ByteRange* grown = realloc(*ranges, grown_capacity * sizeof(struct ByteRange));
+        if (!grown) {
+            return -1;
+        }
+        *ranges = grown;
+        *capacity = grown_capacity;
+    }
+    (*ranges)[*count].offset = offset;
+    (*ranges)[*count].length = end - offset;
+    (*count)++;
+    return 0;
+}
+
+/*
+ * Collect the file byte ranges holding the sample data of one preset.
+ * Appends the ranges, sorted and merged, to the array and returns how many
+ * were added, or -1 on failure
+ */
+int preset_sample_ranges(const SF2Hydra* hydra, int bank, int prog, uint8_t* used,
+                         struct ByteRange** ranges, uint32_t* count, uint32_t* capacity) {
+    uint32_t first = *count;
+
+    // Find the preset header; the last record is the terminal EOP
+    uint32_t p;
+    for (p = 0; p + 1 < hydra->phdr_count; p++) {
+        if (hydra->phdr[p].bank == bank && hydra->phdr[p].preset == prog) {
+            break;
+        }
+    }
+    if (p + 1 >= hydra->phdr_count) {
+        return 0;
+    }
+
+    memset(used, 0, hydra->shdr_count);
+    sf2_hydra_preset_samples(hydra, p, used);
+
+    for (uint32_t s = 0; s + 1 < hydra->shdr_count; s++) {
+        if (!used[s]) {
+            continue;
+        }
+        const SF2SampleHeader* h = &hydra->shdr[s];
+        uint64_t start, end;
+        if (h->sample_type & 0x10) {
+            // Compressed (SF3) samples are addressed in bytes
+            start = h->start;
+            end = h->end;
+        } else {
+            // 16-bit samples are addressed in data points, followed by guard points
+            start = (uint64_t)h->start * 2;
+            end = ((uint64_t)h->end + SF2_SAMPLE_GUARD_POINTS) * 2;
+        }
+        if (end > hydra->smpl_size) end = hydra->smpl_size;
+        if (start >= end) {
+            continue;
+        }
+        if (append_range(ranges, count, capacity, hydra->smpl_offset + start, hydra->smpl_offset + end) != 0) {
+            return -1;
+        }
+
+        // The 24-bit extension holds one extra byte per data point
+        if (hydra->sm24_size && !(h->sample_type & 0x10)) {
+            uint64_t start24 = start / 2, end24 = end / 2;
+            if (end24 > hydra->sm24_size) end24 = hydra->sm24_size;
+            if (start24 < end24 &&
+                append_range(ranges, count, capacity, hydra->sm24_offset + start24, hydra->sm24_offset + end24) != 0) {
+                return -1;
+            }
+        }
+    }
+
+    // Sort and merge overlapping or adjacent ranges
+    uint32_t added = *count - first;
+    struct ByteRange* r = *ranges + first;
+    qsort(r, added, sizeof(struct ByteRange), compare_ranges);
+    uint32_t merged = 0;
+    for (uint32_t i = 0; i < added; i++) {
+        if (merged > 0 && r[i].offset <= r[merged - 1].offset + r[merged - 1].length) {
+            uint64_t end = r[i].offset + r[i].length;
+            if (end > r[merged - 1].offset + r[merged - 1].length) {
+                r[merged - 1].length = end - r[merged - 1].offset;
+            }
+        } else {
+            r[merged++] = r[i];
+        }
+    }
+    *count = first + merged;
+    return (int)merged;
+}
+
+/*
+ * Write the binary preset index (see preset_index.h) for the bundled SoundFont.
+ * Returns 0 on success, -1 on failure
+ */
+int write_preset_index(const char* index_path, const char* sf_path,
+                       const struct PresetMapping* mappings, int total_presets) {
+    FILE* sf = fopen(sf_path, "rb");
+    if (!sf) {
+        perror("Failed to open soundfont for indexing");
+        return -1;
+    }
+    SF2Hydra hydra;
+    char err[256];
+    int result = sf2_hydra_read(sf, &hydra, err, sizeof(err));
+    fclose(sf);
+    if (result != 0) {
+        fprintf(stderr, "Failed to read soundfont structure: %s\n", err);
+        return -1;
+    }
+
+    uint8_t* used = malloc(hydra.shdr_count);
+    uint8_t* records = calloc(total_presets, PRESET_INDEX_PRESET_SIZE);
+    struct ByteRange* ranges = NULL;
+    uint32_t range_count = 0, range_capacity = 0;
+    result = (used && records) ? 0 : -1;
+
+    // One record per preset, pointing at its slice of the range table
+    for (int i = 0; i < total_presets && result == 0; i++) {
+        uint32_t first = range_count;
+        int added = preset_sample_ranges(&hydra, mappings[i].bank, mappings[i].prog, used,
+                                         &ranges, &range_count, &range_capacity);
+        if (added < 0) {
+            result = -1;
+            break;
+        }
+        uint8_t* rec = records + (size_t)i * PRESET_INDEX_PRESET_SIZE;
+        preset_index_put_u16(rec, (uint16_t)mappings[i].bank);
+        preset_index_put_u16(rec + 2, (uint16_t)mappings[i].prog);
+        preset_index_put_u32(rec + 4, first);
+        preset_index_put_u32(rec + 8, (uint32_t)added);
+        strncpy((char*)rec + 12, mappings[i].name, PRESET_INDEX_NAME_SIZE);
+    }
+
+    FILE* out = NULL;
+    if (result == 0) {
+        out = fopen(index_path, "wb");
+        if (!out) {
+            perror("Failed to open preset index");
+            result = -1;
+        }
+    }
+
+    if (result == 0) {
+        uint8_t header[PRESET_INDEX_HEADER_SIZE];
+        memcpy(header, PRESET_INDEX_MAGIC, 4);
+        preset_index_put_u32(header + 4, PRESET_INDEX_VERSION);
+        preset_index_put_u32(header + 8, (uint32_t)total_presets);
+        preset_index_put_u32(header + 12, range_count);
+        if (fwrite(header, 1, sizeof(header), out) != sizeof(header) ||
+            fwrite(records, PRESET_INDEX_PRESET_SIZE, total_presets, out) != (size_t)total_presets) {
+            result = -1;
+        }
+        for (uint32_t i = 0; i < range_count && result == 0; i++) {
+            uint8_t rec[PRESET_INDEX_RANGE_SIZE];
+            preset_index_put_u64(rec, ranges[i].offset);
+            preset_index_put_u64(rec + 8, ranges[i].length);
+            if (fwrite(rec, 1, sizeof(rec), out) != sizeof(rec)) {
+                result = -1;
+            }
+        }
+        if (fclose(out) != 0) {
+            result = -1;
+        }
+    }
+
+    if (result == 0) {
+        fprintf(stderr, "Wrote preset index: %d presets, %u sample ranges\n", total_presets, range_count);
+    }
+
+    free(ranges);
+    free(records);
+    free(used);
+    sf2_hydra_free(&hydra);
+    return result;
+}
+
 /* Sanitize names for use in filenames and URIs */
 void sanitize_name(char* name) {
     for (int i = 0; name[i]; ++i) {
@@ -37,34 +295,99 @@ void sanitize_name(char* name) {
     }
 }
 
-/* Utility function to copy files with error checking */
+/* Clone src into the already opened dst without moving the data through
+   user space: a reflink where the file system supports it, otherwise an
+   in-kernel copy. Returns 0 on success, -1 if neither is available (dst is
+   left empty then). */
+static int copy_file_kernel(int src, int dst, off_t size) {
+#ifdef __linux__
+#ifdef FICLONE
+    if (ioctl(dst, FICLONE, src) == 0) {
+        return 0;
+    }
+#endif
+    off_t copied = 0;
+    while (copied < size) {
+        ssize_t n = copy_file_range(src, NULL, dst, NULL, (size_t)(size - copied), 0);
+        if (n <= 0) {
+            if (copied == 0 && n < 0 && (errno == ENOSYS || errno == EXDEV ||
+                                         errno == EINVAL || errno == EOPNOTSUPP)) {
+                return -1;
+            }
+            if (n == 0) {
+                break; // source shrank
+            }
+            perror("Failed to copy soundfont file");
+            exit(1);
+        }
+        copied += n;
+    }
+    return 0;
+#else
+    (void)src; (void)dst; (void)size;
+    return -1;
+#endif
+}
+
+/* Put a copy of src_path at dst_path. The SoundFont is by far the largest
+   file in the bundle and is never modified, so a hard link is preferred,
+   then a reflink or in-kernel copy, and only then a buffered copy. */
 void copy_file(const char* src_path, const char* dst_path) {
-    FILE* src = fopen(src_path, "rb");
-    if (!src) {
+    struct stat src_st, dst_st;
+    if (stat(src_path, &src_st) != 0) {
         perror("Failed to open source file");
         exit(1);
     }
 
-    FILE* dst = fopen(dst_path, "wb");
-    if (!dst) {
+    // Already in place (rebuild from the bundle's own copy)
+    if (stat(dst_path, &dst_st) == 0 &&
+        src_st.st_dev == dst_st.st_dev && src_st.st_ino == dst_st.st_ino) {
+        return;
+    }
+
+    unlink(dst_path);
+    if (link(src_path, dst_path) == 0) {
+        fprintf(stderr, "Linked soundfont into the bundle\n");
+        return;
+    }
+
+    int src = open(src_path, O_RDONLY);
+    if (src < 0) {
+        perror("Failed to open source file");
+        exit(1);
+    }
+
+    int dst = open(dst_path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (dst < 0) {
         perror("Failed to open destination file");
-        fclose(src);
+        close(src);
         exit(1);
     }
 
-    char buffer[8192];
-    size_t bytes;
-    while ((bytes = fread(buffer, 1, sizeof(buffer), src)) > 0) {
-        if (fwrite(buffer, 1, bytes, dst) != bytes) {
-            perror("Failed to write to destination file");
-            fclose(src);
-            fclose(dst);
+    if (copy_file_kernel(src, dst, src_st.st_size) != 0) {
+        static char buffer[1 << 20];
+        ssize_t bytes;
+        while ((bytes = read(src, buffer, sizeof(buffer))) > 0) {
+            if (write(dst, buffer, (size_t)bytes) != bytes) {
+                perror("Failed to write to destination file");
+                close(src);
+                close(dst);
+                exit(1);
+            }
+        }
+        if (bytes < 0) {
+            perror("Failed to read source file");
+            close(src);
+            close(dst);
             exit(1);
         }
     }
 
-    fclose(src);
-    fclose(dst);
+    close(src);
+    if (close(dst) != 0) {
+        perror("Failed to write to destination file");
+        exit(1);
+    }
 }
 
 int main(int argc, char** argv) {
@@ -72,10 +395,13 @@ int main(int argc, char** argv) {
     
     // Check command line arguments
     if (argc < 2) {
-        printf("Usage: %s <soundfont.sf2>\n", argv[0]);
+        printf("Usage: %s <soundfont.sf2> [plugin name]\n", argv[0]);
         return 1;
     }
 
+    // Plugin name from the command line, so one generator serves every SoundFont
+    const char* plugin_name = (argc >= 3 && argv[2][0]) ? argv[2] : PLUGIN_NAME;
+
     // Process SoundFont filename
     char soundfont_name[256];
     strncpy(soundfont_name, argv[1], 255);
@@ -97,7 +423,7 @@ int main(int argc, char** argv) {
 
     // Set up output directory structure - use clean path with no subdirectories for the soundfont
     char output_dir[4096];
-    snprintf(output_dir, sizeof(output_dir), "build/%s.lv2", PLUGIN_NAME);
+    snprintf(output_dir, sizeof(output_dir), "build/%s.lv2", plugin_name);
     
     // Normalize output directory path to prevent multiple slashes
     size_t len = strlen(output_dir);
@@ -136,8 +462,10 @@ int main(int argc, char** argv) {
     // Copy the soundfont file to the plugin directory with the fixed name
     copy_file(sf_path, final_sf_path);
 
-    // Initialize FluidSynth
+    // Initialize FluidSynth. Only the preset tables are needed here, so sample
+    // data is not loaded; this also skips decoding compressed (SF3) samples
     fluid_settings_t* settings = new_fluid_settings();
+    fluid_settings_setint(settings, "synth.dynamic-sample-loading", 1);
     fluid_synth_t* synth = new_fluid_synth(settings);
     
     // Load the SoundFont file using the correct path in the plugin directory
@@ -159,32 +487,51 @@ int main(int argc, char** argv) {
         return 1;
     }
 
-    // Count total available presets
+    // Collect all presets in banks 0-128 (bank 128 holds drum kits)
+    struct PresetMapping* preset_mappings = NULL;
     int total_presets = 0;
-    int bank, prog;
+    int capacity = 0;
     fluid_preset_t* preset;
 
-    // Scan all banks (including bank 128 for drum kits)
-    for (bank = 0; bank <= 128; bank++) {
-        for (prog = 0; prog < 128; prog++) {
-            preset = fluid_sfont_get_preset(sfont, bank, prog);
-            if (preset != NULL) {
-                total_presets++;
+    fluid_sfont_iteration_start(sfont);
+    while ((preset = fluid_sfont_iteration_next(sfont)) != NULL) {
+        int bank = fluid_preset_get_banknum(preset);
+        if (bank < 0 || bank > 128) {
+            continue;
+        }
+        if (total_presets == capacity) {
+            capacity = capacity ? capacity * 2 : 128;
+            struct PresetMapping* grown = realloc(preset_mappings, capacity * sizeof(struct PresetMapping));
+            if (!grown) {
+                fprintf(stderr, "Failed to allocate preset mapping memory\n");
+                free(preset_mappings);
+                delete_fluid_synth(synth);
+                delete_fluid_settings(settings);
+                return 1;
             }
+            preset_mappings = grown;
         }
+        preset_mappings[total_presets].bank = bank;
+        preset_mappings[total_presets].prog = fluid_preset_get_num(preset);
+        preset_mappings[total_presets].name = fluid_preset_get_name(preset);
+        total_presets++;
     }
 
     if (total_presets == 0) {
         fprintf(stderr, "No presets found in soundfont\n");
+        free(preset_mappings);
         delete_fluid_synth(synth);
         delete_fluid_settings(settings);
         return 1;
     }
+
+    // Program port order is by bank, then program
+    qsort(preset_mappings, total_presets, sizeof(struct PresetMapping), compare_presets);
     fprintf(stderr, "Found %d total presets\n", total_presets);
 
     // Prepare output files
     char ttl_path[4096], manifest_path[4096];
-    if (snprintf(ttl_path, sizeof(ttl_path), "%s/%s.ttl", output_dir, PLUGIN_NAME) >= sizeof(ttl_path)) {
+    if (snprintf(ttl_path, sizeof(ttl_path), "%s/%s.ttl", output_dir, plugin_name) >= sizeof(ttl_path)) {
         fprintf(stderr, "Path too long for TTL file\n");
         return 1;
     }
@@ -208,6 +555,7 @@ int main(int argc, char** argv) {
         "@prefix doap: <http://usefulinc.com/ns/doap#> .\n"
         "@prefix foaf: <http://xmlns.com/foaf/0.1/> .\n"
         "@prefix lv2: <http://lv2plug.in/ns/lv2core#> .\n"
+        "@prefix opts: <http://lv2plug.in/ns/ext/options#> .\n"
         "@prefix rdf: <http://www.w3.org/1999/02/22-rdf-syntax-ns#> .\n"
         "@prefix rdfs: <http://www.w3.org/2000/01/rdf-schema#> .\n\n"
     );
@@ -217,6 +565,11 @@ int main(int argc, char** argv) {
         "<https://github.com/islainstruments/sf2lv2/%s>\n"
         "    a lv2:InstrumentPlugin, lv2:Plugin ;\n"
         "    lv2:requiredFeature <http://lv2plug.in/ns/ext/urid#map> ;\n"
+        "    lv2:optionalFeature <http://lv2plug.in/ns/ext/worker#schedule> ;\n"
+        "    lv2:extensionData <http://lv2plug.in/ns/ext/worker#interface> ;\n"
+        "    lv2:extensionData <http://lv2plug.in/ns/ext/state#interface> ;\n"
+        "    lv2:optionalFeature opts:options ;\n"
+        "    opts:supportedOption <" SF2LV2__polyphony "> , <" SF2LV2__cpuCores "> , <" SF2LV2__dspBudget "> ;\n"
         "    lv2:port [\n"
         "        a lv2:InputPort, atom:AtomPort ;\n"
         "        atom:bufferType atom:Sequence ;\n"
@@ -244,7 +597,7 @@ int main(int argc, char** argv) {
         "        lv2:minimum 0.0 ;\n"
         "        lv2:maximum 2.0 ;\n"
         "    ] , [\n",
-        PLUGIN_NAME
+        plugin_name
     );
 
     // Add Program Control Port definition
@@ -261,36 +614,19 @@ int main(int argc, char** argv) {
         total_presets - 1
     );
 
-    // Allocate memory for preset mappings
-    struct PresetMapping* preset_mappings = malloc(total_presets * sizeof(struct PresetMapping));
-    if (!preset_mappings) {
-        fprintf(stderr, "Failed to allocate preset mapping memory\n");
-        delete_fluid_synth(synth);
-        delete_fluid_settings(settings);
-        return 1;
-    }
-
-    // Store all preset mappings
-    int mapping_index = 0;
+    // List all preset mappings
+    int mapping_index;
     fprintf(stderr, "\nAvailable presets:\n");
-    for (bank = 0; bank <= 128; bank++) {
-        for (prog = 0; prog < 128; prog++) {
-            preset = fluid_sfont_get_preset(sfont, bank, prog);
-            if (preset != NULL) {
-                preset_mappings[mapping_index].bank = bank;
-                preset_mappings[mapping_index].prog = prog;
-                preset_mappings[mapping_index].name = fluid_preset_get_name(preset);
-                // Print first column with Isla Instruments colors
-                fprintf(stderr, "  \033[1;37m%3d\033[0m: [\033[1;31m%3d,%3d\033[0m] \033[0;37m%-24s\033[0m", 
-                        mapping_index, bank, prog, preset_mappings[mapping_index].name);
-                // If this is an even-numbered preset and not the last one, print a separator
-                if (mapping_index % 2 == 0) {
-                    fprintf(stderr, "\033[1;30m|\033[0m ");
-                } else {
-                    fprintf(stderr, "\n");
-                }
-                mapping_index++;
-            }
+    for (mapping_index = 0; mapping_index < total_presets; mapping_index++) {
+        // Print first column with Isla Instruments colors
+        fprintf(stderr, "  \033[1;37m%3d\033[0m: [\033[1;31m%3d,%3d\033[0m] \033[0;37m%-24s\033[0m", 
+                mapping_index, preset_mappings[mapping_index].bank,
+                preset_mappings[mapping_index].prog, preset_mappings[mapping_index].name);
+        // If this is an even-numbered preset and not the last one, print a separator
+        if (mapping_index % 2 == 0) {
+            fprintf(stderr, "\033[1;30m|\033[0m ");
+        } else {
+            fprintf(stderr, "\n");
         }
     }
     // Add a newline if we ended on an even-numbered preset
@@ -369,9 +705,54 @@ int main(int argc, char** argv) {
         "        lv2:minimum 0.0 ;\n"
         "        lv2:maximum 1.0 ;\n"
         "        rdfs:comment \"Maps to MIDI CC 72 (Release Time)\" ;\n"
-        "    ] ;\n"
+        "    ]"
     );
 
+#if CHANNEL_OUTPUTS
+    // Stereo output pair per MIDI channel
+    for (int ch = 0; ch < 16; ch++) {
+        for (int side = 0; side < 2; side++) {
+            fprintf(ttl,
+                " , [\n"
+                "        a lv2:OutputPort, lv2:AudioPort ;\n"
+                "        lv2:index %d ;\n"
+                "        lv2:symbol \"ch%d_out_%s\" ;\n"
+                "        lv2:name \"Channel %d %s\" ;\n"
+                "    ]",
+                CHANNEL_OUT_PORT + 2 * ch + side,
+                ch + 1, side ? "r" : "l",
+                ch + 1, side ? "Right" : "Left"
+            );
+        }
+    }
+#endif
+#if PERF_PORTS
+    for (size_t i = 0; i < sizeof(perf_ports) / sizeof(perf_ports[0]); i++) {
+        fprintf(ttl,
+            " , [\n"
+            "        a lv2:OutputPort, lv2:ControlPort ;\n"
+            "        lv2:index %d ;\n"
+            "        lv2:symbol \"%s\" ;\n"
+            "        lv2:name \"%s\" ;\n"
+            "%s"
+            "        lv2:minimum 0 ;\n"
+            "        lv2:maximum %d ;\n"
+            "        rdfs:comment \"%s\" ;\n"
+            "    ]",
+            PERF_PORT + (int)i,
+            perf_ports[i].symbol, perf_ports[i].name,
+            perf_ports[i].integer ? "        lv2:portProperty lv2:integer ;\n" : "",
+            perf_ports[i].maximum, perf_ports[i].comment
+        );
+    }
+#endif
+    fprintf(ttl, " ;\n");
+
+    const char* mode_note = MULTITIMBRAL
+        ? "\\nMulti-timbral: plays all 16 MIDI channels with per-channel program change and bank select. "
+          "The Program, Cutoff, Resonance and envelope controls apply to MIDI channel 1."
+        : "";
+
     // Write plugin metadata
     fprintf(ttl,
         "    doap:name \"%s\" ;\n"
@@ -380,10 +761,29 @@ int main(int argc, char** argv) {
         "        foaf:name \"Isla Instruments\" ;\n"
         "        foaf:homepage <https://www.islainstruments.com> ;\n"
         "    ] ;\n"
-        "    rdfs:comment \"This plugin wraps the %s soundfont as an LV2 instrument.\\nBuilt using FluidSynth as the synthesizer engine.\" ;\n"
+        "    rdfs:comment \"This plugin wraps the %s soundfont as an LV2 instrument.\\nBuilt using FluidSynth as the synthesizer engine.%s\" ;\n"
         "    lv2:minorVersion 2 ;\n"
         "    lv2:microVersion 0 .\n",
-        PLUGIN_NAME, display_name
+        plugin_name, display_name, mode_note
+    );
+
+    // Describe the instantiation options
+    fprintf(ttl,
+        "\n<" SF2LV2__polyphony ">\n"
+        "    a rdf:Property ;\n"
+        "    rdfs:label \"Polyphony\" ;\n"
+        "    rdfs:comment \"Maximum number of voices\" ;\n"
+        "    rdfs:range atom:Int .\n"
+        "\n<" SF2LV2__cpuCores ">\n"
+        "    a rdf:Property ;\n"
+        "    rdfs:label \"CPU cores\" ;\n"
+        "    rdfs:comment \"Number of threads FluidSynth renders with\" ;\n"
+        "    rdfs:range atom:Int .\n"
+        "\n<" SF2LV2__dspBudget ">\n"
+        "    a rdf:Property ;\n"
+        "    rdfs:label \"DSP budget\" ;\n"
+        "    rdfs:comment \"Share of the audio period, in percent, that the voice governor keeps processing within (0 disables the governor)\" ;\n"
+        "    rdfs:range atom:Float .\n"
     );
 
     fclose(ttl);
@@ -398,11 +798,37 @@ int main(int argc, char** argv) {
             "    a lv2:Plugin ;\n"
             "    lv2:binary <%s.so> ;\n"
             "    rdfs:seeAlso <%s.ttl> .\n",
-            PLUGIN_NAME, PLUGIN_NAME, PLUGIN_NAME
+            plugin_name, plugin_name, plugin_name
         );
         fclose(manifest);
     }
 
+    // Write the bundle descriptor the plugin binary reads its URI and name from
+    char desc_path[4096];
+    snprintf(desc_path, sizeof(desc_path), "%s/%s", output_dir, BUNDLE_DESC_FILE);
+    FILE* desc = fopen(desc_path, "w");
+    if (!desc) {
+        perror("Failed to open bundle descriptor");
+        delete_fluid_synth(synth);
+        delete_fluid_settings(settings);
+        free(preset_mappings);
+        return 1;
+    }
+    fprintf(desc,
+        BUNDLE_DESC_URI "=" SF2LV2_URI "/%s\n"
+        BUNDLE_DESC_NAME "=%s\n",
+        plugin_name, plugin_name
+    );
+    fclose(desc);
+
+    // Write the binary preset index used by the plugin at instantiate
+    char index_path[4096];
+    snprintf(index_path, sizeof(index_path), "%s/%s", output_dir, PRESET_INDEX_FILE);
+    if (write_preset_index(index_path, final_sf_path, preset_mappings, total_presets) != 0) {
+        fprintf(stderr, "Warning: preset index not written, plugin will scan presets at load\n");
+        remove(index_path);
+    }
+
     // Cleanup
     delete_fluid_synth(synth);
     delete_fluid_settings(settings);